@@ -0,0 +1,92 @@
+#pragma once
+#include <ff_cpp/ff_decoder.h>
+#include <ff_cpp/ff_demuxer.h>
+#include <ff_cpp/ff_frame.h>
+#include <ff_cpp/ff_include.h>
+
+#include <memory>
+#include <string>
+
+namespace ff_cpp {
+
+/**
+ * @brief Parameters of GOP-parallel decoding
+ */
+struct BatchOptions {
+  /**
+   * @brief number of decoding threads, 0 - number of CPU cores
+   */
+  size_t threads = 0;
+  /**
+   * @brief stream to decode, -1 - best video stream
+   */
+  int streamIndex = -1;
+  /**
+   * @brief deliver frames in the same order as sequential decoding does,
+   * otherwise frames are delivered as soon as they decoded, use Frame::pts()
+   * to order them
+   */
+  bool ordered = true;
+  /**
+   * @brief number of consecutive GOPs decoded by a thread at once
+   */
+  size_t gopsPerRange = 1;
+  /**
+   * @brief max number of decoded frames each thread buffers while waiting for
+   * delivery, it bounds memory usage
+   */
+  size_t framesPerThread = 64;
+  /**
+   * @brief options of decoders, parallelism is on GOP level so each decoder
+   * uses one thread by default
+   */
+  DecoderOptions decoderOptions{1};
+};
+
+/**
+ * @brief Decoder of local files for batch processing. Keyframes of the stream
+ * are indexed and the file is split into GOP-aligned ranges, each range is
+ * decoded by its own demuxer and decoder on a pool of threads
+ * @note ranges are expected to be closed GOPs, frames referencing previous
+ * GOP could be lost or corrupted at range boundaries
+ */
+class BatchDecoder {
+ public:
+  /**
+   * @brief BatchDecoder constructor
+   *
+   * @param inputSource - url of input source, it is opened by each thread
+   * @param inputFormat - format you want to force demuxer to use
+   */
+  FF_CPP_API explicit BatchDecoder(const std::string& inputSource,
+                                   const std::string& inputFormat = "");
+  FF_CPP_API ~BatchDecoder();
+
+  /**
+   * @brief Decode whole stream, this is blocking function which returns when
+   * all frames delivered or stop() called
+   *
+   * @param fc frame callback, called on the calling thread
+   * @param options threads and delivery order
+   * @note Frame received in frame callback is valid only during callback
+   * call, use Frame::ref() to keep it
+   * @exception BadInput, NoStream, TimeoutElapsed - if input not opened as in
+   * Demuxer::prepare()
+   * @exception ProcessingError if error occured while demuxing\decoding
+   */
+  FF_CPP_API void decode(frame_callback fc, const BatchOptions& options = {});
+
+  /**
+   * @brief Stop decoding routine
+   */
+  FF_CPP_API void stop();
+
+ private:
+  BatchDecoder(const BatchDecoder&) = delete;
+  BatchDecoder& operator=(const BatchDecoder&) = delete;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ff_cpp
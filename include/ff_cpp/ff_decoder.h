@@ -7,6 +7,130 @@
 
 namespace ff_cpp {
 
+/**
+ * @brief Which frames decoder outputs
+ */
+enum class DecodeMode {
+  /**
+   * @brief every frame
+   */
+  All,
+  /**
+   * @brief only keyframes, other packets are dropped before decoding
+   */
+  KeyframesOnly,
+  /**
+   * @brief about DecoderOptions::targetFps frames per second, packets of
+   * non-reference frames which are not due are dropped or skipped by decoder,
+   * decoded frames which are not due are dropped
+   */
+  TargetFps
+};
+
+/**
+ * @brief Decoding speed versus picture quality
+ */
+enum class DecodeSpeed {
+  /**
+   * @brief bit-exact decoding
+   */
+  Exact,
+  /**
+   * @brief AV_CODEC_FLAG2_FAST, loop filter skipped for non-reference frames
+   */
+  Fast,
+  /**
+   * @brief AV_CODEC_FLAG2_FAST, loop filter skipped for all frames, IDCT
+   * skipped for bidirectional frames and half resolution (lowres) if codec
+   * supports it, so frames could be smaller than stream resolution
+   */
+  Fastest
+};
+
+/**
+ * @brief Decoder statistics
+ */
+struct DecoderStats {
+  /**
+   * @brief frames returned by receiveFrame()
+   */
+  uint64_t decoded{};
+  /**
+   * @brief packets dropped before decoding and decoded frames dropped by
+   * decode mode
+   * @note frames of not due packets skipped by libavcodec itself
+   * (skip_frame) are not counted
+   */
+  uint64_t skipped{};
+};
+
+/**
+ * @brief Threading and decode mode of decoder
+ */
+struct DecoderOptions {
+  /**
+   * @brief number of decoding threads, 0 - libavcodec default
+   */
+  int threadCount = 0;
+  /**
+   * @brief allowed threading methods, FF_THREAD_FRAME and/or FF_THREAD_SLICE
+   */
+  int threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  /**
+   * @brief take share of process-wide decode thread budget instead of
+   * threadCount, see setDecodeThreadBudget()
+   */
+  bool shareThreadBudget = false;
+  /**
+   * @brief which frames decoder outputs
+   */
+  DecodeMode mode = DecodeMode::All;
+  /**
+   * @brief output frame rate for DecodeMode::TargetFps
+   * @note time base of packets must be known, see setPacketTimeBase()
+   */
+  double targetFps = 1;
+  /**
+   * @brief degraded decoding for workloads which don't need exact pixels
+   */
+  DecodeSpeed speed = DecodeSpeed::Exact;
+  /**
+   * @brief export motion vectors as frame side data (export_mvs), see
+   * Frame::motionVectors() and motionScore()
+   */
+  bool exportMotionVectors = false;
+};
+
+/**
+ * @brief Process-wide number of decoding threads shared by all live decoders
+ * created with DecoderOptions::shareThreadBudget
+ */
+struct DecodeThreadBudget {
+  /**
+   * @brief total number of decoding threads, 0 - number of CPU cores
+   */
+  unsigned int threads = 0;
+  /**
+   * @brief expected number of simultaneously live decoders. Decoder gets
+   * threads / max(decoders, live decoders + 1), but not more than threads
+   * left by live decoders and at least one thread, so decoders created in a
+   * burst don't take more than the budget while it lasts
+   */
+  unsigned int decoders = 1;
+};
+
+/**
+ * @brief Set process-wide decode thread budget
+ * @note thread count of a decoder is chosen when it is opened, already opened
+ * decoders keep their threads
+ */
+FF_CPP_API void setDecodeThreadBudget(const DecodeThreadBudget& budget);
+
+/**
+ * @brief Current process-wide decode thread budget
+ */
+FF_CPP_API DecodeThreadBudget decodeThreadBudget();
+
 class Decoder {
  public:
   /**
@@ -15,6 +139,7 @@ class Decoder {
    * @param codecId
    * @param codecpar
    * @param userParams
+   * @param options threading of decoder, "threads" in userParams overrides it
    * @exception NoDecoder if unable to find decoder for required codec id or
    * unable to open codec
    * @exception FFCppException if unable to alloc decoder context or codecpar
@@ -23,7 +148,8 @@ class Decoder {
    * @return FF_CPP_API
    */
   FF_CPP_API explicit Decoder(AVCodecID codecId, AVCodecParameters* codecpar = nullptr,
-                     const ParametersContainer& userParams = {});
+                     const ParametersContainer& userParams = {},
+                     const DecoderOptions& options = {});
   FF_CPP_API Decoder(Decoder&&);
   FF_CPP_API ~Decoder();
 
@@ -32,9 +158,40 @@ class Decoder {
   FF_CPP_API int width() const;
   FF_CPP_API int height() const;
   FF_CPP_API int format() const;
+  /**
+   * @brief Number of threads decoder opened with
+   */
+  FF_CPP_API int threadCount() const;
+  /**
+   * @brief Time base of packets and frames timestamps, Demuxer::createDecoder
+   * sets it to time base of the stream
+   */
+  FF_CPP_API void setPacketTimeBase(AVRational timeBase);
+  /**
+   * @brief Decoded and skipped frames counters, could be read from any thread
+   * while decoder is in use
+   */
+  FF_CPP_API DecoderStats stats() const;
+  /**
+   * @brief Drop buffered packets and frames, call it after seek or to decode
+   * again after decoder was drained by empty packet
+   */
+  FF_CPP_API void flush();
 
-  FF_CPP_API int sendPacket(Packet& pkt) const;
-  FF_CPP_API int receiveFrame(Frame& frame);
+  /**
+   * @brief Send packet to decoder, packet could be dropped by decode mode
+   *
+   * @return 0 if packet sent or dropped, negative AVERROR otherwise
+   */
+  FF_CPP_API int sendPacket(Packet& pkt) noexcept;
+  /**
+   * @brief Receive decoded frame, frames which are not due in
+   * DecodeMode::TargetFps are dropped
+   *
+   * @return 0 on success, AVERROR(EAGAIN) if new packet required, AVERROR_EOF
+   * if decoder flushed, other negative AVERROR in case of error
+   */
+  FF_CPP_API int receiveFrame(Frame& frame) noexcept;
 
   FF_CPP_API friend std::ostream& operator<<(std::ostream& ost,
                                              const Decoder& dcdr);
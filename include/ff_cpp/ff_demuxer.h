@@ -1,15 +1,23 @@
 #pragma once
+#include <chrono>
 #include <functional>
+#include <future>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <ff_cpp/ff_decoder.h>
+#include <ff_cpp/ff_drop_policy.h>
 #include <ff_cpp/ff_frame.h>
 #include <ff_cpp/ff_include.h>
+#include <ff_cpp/ff_io.h>
 #include <ff_cpp/ff_packet.h>
+#include <ff_cpp/ff_status.h>
 #include <ff_cpp/ff_stream.h>
+#include <ff_cpp/ff_stream_info_cache.h>
 
 namespace ff_cpp {
 
@@ -17,6 +25,8 @@ namespace ff_cpp {
  * @brief acket_callback will called each time new packed received
  * required return true to decode packet, false to discard it
  * @note return true has a sense only if decoder for appropriate stream created
+ * @note packet could be moved out to keep it after callback returned, false
+ * must be returned then
  */
 using packet_callback = std::function<bool(Packet&)>;
 
@@ -25,6 +35,142 @@ using packet_callback = std::function<bool(Packet&)>;
  */
 using frame_callback = std::function<void(Frame&)>;
 
+/**
+ * @brief Parameters of pipelined demuxing/decoding routine
+ */
+struct PipelineOptions {
+  /**
+   * @brief max number of packets queued for each decoder
+   */
+  size_t packetQueueSize = 32;
+  /**
+   * @brief max number of decoded frames waiting for frame callback
+   */
+  size_t frameQueueSize = 8;
+  /**
+   * @brief policy of packet queues between demux and decode threads
+   */
+  DropPolicy packetPolicy = DropPolicy::Block;
+  /**
+   * @brief policy of frame queue between decode threads and frame callback
+   */
+  DropPolicy framePolicy = DropPolicy::Block;
+};
+
+/**
+ * @brief Items dropped by queues of pipelined routine, see DropPolicy
+ */
+struct PipelineStats {
+  uint64_t packetsDropped{};
+  uint64_t framesDropped{};
+};
+
+/**
+ * @brief Parameters of frame subscriber, see Demuxer::subscribe()
+ */
+struct SubscriberOptions {
+  /**
+   * @brief max number of frames waiting for subscriber callback
+   */
+  size_t queueSize = 8;
+  /**
+   * @brief what to do when subscriber is slow, DropPolicy::Block stalls
+   * decoding for the demuxer and all its subscribers
+   */
+  DropPolicy policy = DropPolicy::DropOldest;
+  /**
+   * @brief receive frames of this stream only, -1 means all streams
+   */
+  int streamIndex = -1;
+};
+
+/**
+ * @brief Statistics of frame subscriber
+ */
+struct SubscriberStats {
+  size_t id{};
+  /**
+   * @brief number of frames passed to subscriber callback
+   */
+  uint64_t delivered{};
+  /**
+   * @brief number of frames dropped according to subscriber policy
+   */
+  uint64_t dropped{};
+  /**
+   * @brief exception thrown by subscriber callback, subscriber gets no more
+   * frames after it
+   */
+  std::exception_ptr error;
+};
+
+/**
+ * @brief Decoding timestamps of keyframes of one stream in ascending order,
+ * packets with the same timestamps could be found after seek to them.
+ * Index could be saved to a sidecar file after first pass over input and
+ * loaded later instead of building it again
+ *
+ * @code
+ * ff_cpp::KeyframeIndex index;
+ * try {
+ *   index = ff_cpp::KeyframeIndex::load(sidecar);
+ * } catch (const ff_cpp::BadInput&) {
+ *   index = demuxer.keyframeIndex(streamIndex);
+ *   index.save(sidecar);
+ * }
+ * demuxer.setKeyframeIndex(index);
+ * @endcode
+ */
+struct KeyframeIndex {
+  int streamIndex{-1};
+  AVRational timeBase{0, 1};
+  std::vector<int64_t> timestamps;
+  /**
+   * @brief byte positions of keyframes in input, -1 if unknown
+   */
+  std::vector<int64_t> positions;
+  /**
+   * @brief identity of indexed input: its size in bytes and duration of the
+   * stream in timeBase units, -1 and AV_NOPTS_VALUE if unknown
+   */
+  int64_t inputSize{-1};
+  int64_t duration{AV_NOPTS_VALUE};
+
+  /**
+   * @brief Save index to text file
+   * @exception FFCppException - if unable to write file
+   */
+  FF_CPP_API void save(const std::string& path) const;
+  /**
+   * @brief Load index saved by save()
+   * @exception BadInput - if unable to read file or file malformed
+   */
+  FF_CPP_API static KeyframeIndex load(const std::string& path);
+};
+
+/**
+ * @brief Startup time of the last Demuxer::prepare()
+ */
+struct PrepareStats {
+  /**
+   * @brief time spent to open input and read its header
+   */
+  std::chrono::microseconds openInput{};
+  /**
+   * @brief time spent to probe streams, zero if probing was skipped
+   */
+  std::chrono::microseconds findStreamInfo{};
+  std::chrono::microseconds total{};
+  /**
+   * @brief true if stream parameters were taken from StreamInfoCache
+   */
+  bool streamInfoCached{};
+};
+
+template <typename T>
+class DemuxerRange;
+struct PrepareResult;
+
 class Demuxer {
  public:
   /**
@@ -36,6 +182,25 @@ class Demuxer {
    */
   FF_CPP_API explicit Demuxer(const std::string& inputSource,
                               const std::string& inputFormat = "");
+  /**
+   * @brief Demuxer constructor for custom input source, input is read through
+   * custom AVIOContext instead of libavformat protocols
+   *
+   * @param source - input source, for example MemorySource
+   * @param inputFormat - format you want to force demuxer to use
+   */
+  FF_CPP_API explicit Demuxer(std::shared_ptr<IOSource> source,
+                              const std::string& inputFormat = "");
+  /**
+   * @brief Demuxer constructor for input located in memory
+   * @note buffer must exists until demuxer not destroyed
+   *
+   * @param data - input buffer
+   * @param size - buffer size
+   * @param inputFormat - format you want to force demuxer to use
+   */
+  FF_CPP_API Demuxer(const uint8_t* data, size_t size,
+                     const std::string& inputFormat = "");
   FF_CPP_API ~Demuxer();
 
   /**
@@ -44,16 +209,57 @@ class Demuxer {
   FF_CPP_API const std::string& inputSource() const;
 
   /**
-   * @brief Prepare input to use
+   * @brief Prepare input to use, preparing again drops decoders, handlers and
+   * keyframe indexes of previous input once the new one is opened
    * @exception OptionsNotAccepted - not all parameters passed in constructor
    * are accepted
    * @exception BadInput - open input failed
    * @exception NoStream - if find stream info failed
    * @exception TimeoutElapsed - if timeout elapsed while find stream info
+   * @exception Interrupted - if stop() called while prepare
    */
   FF_CPP_API void prepare(const ParametersContainer& params = {},
                           unsigned int timeout = 15);
 
+  /**
+   * @brief Non throwing prepare(), failures are returned instead of thrown,
+   * so opening of many inputs doesn't pay for exception unwinding
+   *
+   * @return status with code of exception prepare() would throw, StatusCode::
+   * Error if unexpected failure, like out of memory, happened
+   */
+  FF_CPP_API Status tryPrepare(const ParametersContainer& params = {},
+                               unsigned int timeout = 15) noexcept;
+
+  /**
+   * @brief Prepare input in separate thread, see prepare(). stop() called
+   * after prepareAsync() returned interrupts prepare, even if it is not
+   * started yet
+   *
+   * @return future which rethrows exceptions of prepare(), demuxer must not
+   * be used until it is ready
+   */
+  FF_CPP_API std::future<void> prepareAsync(
+      const ParametersContainer& params = {}, unsigned int timeout = 15);
+
+  /**
+   * @brief Use cached stream parameters to speed up prepare(), parameters
+   * probed by prepare() are stored to the cache. Input with changed stream
+   * layout is probed as usual
+   *
+   * @param cache - cache, could be shared by several demuxers, nullptr
+   * disables caching
+   * @param probe - how to probe input which is found in cache
+   * @note must be called before prepare()
+   */
+  FF_CPP_API void setStreamInfoCache(std::shared_ptr<StreamInfoCache> cache,
+                                     StartupProbe probe = StartupProbe::Skip);
+
+  /**
+   * @brief Startup time of the last prepare()
+   */
+  FF_CPP_API PrepareStats prepareStats() const;
+
   /**
    * @brief Return sources metadata
    *
@@ -76,7 +282,7 @@ class Demuxer {
   FF_CPP_API const std::vector<Stream>& streams() const;
 
   /**
-   * @brief Find best video stream
+   * @brief Find best video stream, it is found once in prepare()
    * @exception FFCppException - if demuxer not prepared
    * @exception NoStream - if find best video stream failed
    * @return FFStream
@@ -84,15 +290,106 @@ class Demuxer {
   FF_CPP_API Stream& bestVideoStream() const;
 
   /**
-   * @brief Create a Decoder object
+   * @brief Demux only selected streams, other streams are discarded inside
+   * libavformat (AVStream::discard = AVDISCARD_ALL), so their packets never
+   * reach packet callback or readPacket()
+   *
+   * @param streamIndexes - streams to keep, empty list selects all streams
+   * @exception FFCppException - if demuxer not prepared
+   * @exception NoStream - if any of indexes out of range
+   */
+  FF_CPP_API void selectStreams(const std::vector<size_t>& streamIndexes);
+
+  /**
+   * @brief Seek input, created decoders are flushed and state of nextFrame()
+   * is reset
+   *
+   * @param timestamp - in time base of stream or in AV_TIME_BASE units if
+   * streamIndex is -1
+   * @param flags - AVSEEK_FLAG_* flags of av_seek_frame()
+   * @param streamIndex - stream timestamp relates to
+   * @exception FFCppException - if demuxer not prepared
+   * @exception TimeoutElapsed - if timeout elapsed while seek
+   * @exception ProcessingError - if seek failed
+   */
+  FF_CPP_API void seek(int64_t timestamp, int flags = 0, int streamIndex = -1);
+
+  /**
+   * @brief Build keyframe index of stream, from index of the container if it
+   * has one or by reading all packets and seeking back to start otherwise
+   *
+   * @param streamIndex - stream to index
+   * @exception FFCppException - if demuxer not prepared
+   * @exception NoStream - if streamIndex out of range
+   * @exception TimeoutElapsed, ProcessingError - if reading or seeking failed
+   */
+  FF_CPP_API KeyframeIndex keyframeIndex(size_t streamIndex);
+
+  /**
+   * @brief Use keyframe index in frameAt(), for example loaded from sidecar
+   * file. Keyframe is found by binary search, then input is seeked by its
+   * byte position if format supports it, so demuxer doesn't search timestamp
+   * itself
+   *
+   * @exception NoStream - if stream of index out of range
+   * @exception BadInput - if time base of index differs from the stream one
+   * or index is built for input of other size or stream duration
+   */
+  FF_CPP_API void setKeyframeIndex(const KeyframeIndex& index);
+
+  /**
+   * @brief Accurate seek, seek to keyframe before pts and decode forward
+   * until frame displayed at pts
+   *
+   * @param streamIndex - stream to decode, its decoder must be created
+   * @param pts - presentation timestamp in time base of stream
+   * @return last frame with pts not greater than required one, or first frame
+   * of stream if pts is before it
+   * @exception FFCppException - if demuxer not prepared or there is no decoder
+   * for stream
+   * @exception NoStream - if streamIndex out of range
+   * @exception EndOfFile - if stream has not any frame
+   * @exception TimeoutElapsed, ProcessingError - if seek, reading or decoding
+   * failed
+   */
+  FF_CPP_API Frame frameAt(size_t streamIndex, int64_t pts);
+
+  /**
+   * @brief Create a Decoder object, decoder created for the stream before is
+   * replaced
    *
    * @param streamIndex you want to decode
    * @param requiredCodec user specified codec
+   * @param options threading of decoder
    * @exception NoStream - if streamIndex out of range
    * @return FFDecoder&
    */
   FF_CPP_API Decoder& createDecoder(size_t streamIndex,
-                                    AVCodecID requiredCodec = AV_CODEC_ID_NONE);
+                                    AVCodecID requiredCodec = AV_CODEC_ID_NONE,
+                                    const DecoderOptions& options = {});
+
+  /**
+   * @brief Register packet handler for one stream, it is called instead of
+   * packet callback passed to start() for packets of this stream
+   *
+   * @param streamIndex - stream handler is registered for
+   * @param pc - handler, empty function removes registered one
+   * @exception FFCppException - if demuxer not prepared
+   * @exception NoStream - if streamIndex out of range
+   */
+  FF_CPP_API void onPacket(size_t streamIndex, packet_callback pc);
+
+  /**
+   * @brief Register frame handler for one stream, it is called instead of
+   * frame callback passed to start() for frames decoded by decoder of this
+   * stream
+   *
+   * @param streamIndex - stream handler is registered for
+   * @param fc - handler, empty function removes registered one
+   * @exception FFCppException - if demuxer not prepared
+   * @exception NoStream - if streamIndex out of range
+   */
+  FF_CPP_API void onFrame(size_t streamIndex, frame_callback fc);
 
   /**
    * @brief All created decoders, key is stream index
@@ -107,7 +404,7 @@ class Demuxer {
    * @param fc frame callback
    * @param pc packet callback
    * @note AVFrame/AVPacket received in callbacks are valid only during callback
-   * call
+   * call, use Frame::ref() to keep decoded frame without copying its data
    * @exception FFCppException if demuxer not prepared
    * @exception ProcessingError if error occured while demuxind\decoding routine
    * @exception EndOfFile if end of file reached while read frame from input
@@ -118,7 +415,127 @@ class Demuxer {
                         packet_callback pc = [](Packet&) { return true; });
 
   /**
-   * @brief Stop demuxing/decoding routine
+   * @brief The same as start(frame_callback, packet_callback), but callbacks
+   * are called directly, without std::function, so they could be inlined.
+   * It is chosen for lambdas and other callables which are not std::function
+   *
+   * @param fc frame callback, invocable as fc(Frame&)
+   * @param pc packet callback, invocable as bool pc(Packet&)
+   */
+  template <typename FrameFn, typename PacketFn>
+  void start(FrameFn&& fc, PacketFn&& pc);
+
+  /**
+   * @brief The same as start(FrameFn&&, PacketFn&&), but end of file,
+   * timeout and demuxing/decoding errors are returned instead of thrown
+   *
+   * @return StatusCode::EndOfFile at end of file, StatusCode::Interrupted if
+   * stop() called or failure status, see Status::fromError()
+   * @exception FFCppException if demuxer not prepared, exceptions of
+   * callbacks are propagated
+   */
+  template <typename FrameFn, typename PacketFn>
+  Status tryStart(FrameFn&& fc, PacketFn&& pc);
+
+  /**
+   * @brief Start pipelined demuxing/decoding routine, this is blocking
+   * function. Packets are read on a separate demux thread and queued to
+   * per-stream bounded queues, each created decoder runs on its own thread,
+   * decoded frames are queued to the calling thread where fc is called
+   *
+   * @param fc frame callback, called on the calling thread
+   * @param pc packet callback, called on the demux thread
+   * @param options queue sizes and drop policies
+   * @note Frame received in frame callback is owned by the routine and valid
+   * only during callback call, Packet is valid only during packet callback
+   * call. On end of file decoders are flushed and all queued frames are
+   * delivered before EndOfFile is thrown
+   * @exception FFCppException if demuxer not prepared
+   * @exception ProcessingError if error occured while demuxind\decoding routine
+   * @exception EndOfFile if end of file reached while read frame from input
+   * source
+   * @exception TimeoutElapsed if timeout elapsed while read frames
+   */
+  FF_CPP_API void start(frame_callback fc, packet_callback pc,
+                        const PipelineOptions& options);
+
+  /**
+   * @brief Items dropped by running or last pipelined start(), could be
+   * called from any thread
+   */
+  FF_CPP_API PipelineStats pipelineStats() const;
+
+  /**
+   * @brief Subscribe to frames decoded by start(), nextFrame() or
+   * DemuxerPool. Each subscriber gets references to decoded frames, their
+   * data is not copied, on its own thread through its own queue, so one
+   * decoding feeds several consumers
+   *
+   * @param fc - called on subscriber thread, frame could be kept by
+   * Frame::ref()
+   * @param options - queue size, drop policy and stream of subscriber
+   * @return id of subscriber
+   */
+  FF_CPP_API size_t subscribe(frame_callback fc,
+                              const SubscriberOptions& options = {});
+
+  /**
+   * @brief Remove subscriber, frames queued for it are delivered before
+   * return
+   * @note must not be called from callback of the subscriber
+   * @exception FFCppException - if there is no subscriber with such id
+   */
+  FF_CPP_API void unsubscribe(size_t id);
+
+  FF_CPP_API std::vector<SubscriberStats> subscriberStats() const;
+
+  /**
+   * @brief Read next packet of any stream, non throwing alternative to
+   * start() for callers driving their own loop
+   * @note handlers registered by onPacket()/onFrame() are not called
+   *
+   * @param packet - packet to read into, previous content is released
+   * @return 0 on success, AVERROR_EOF if end of file reached,
+   * AVERROR(ETIMEDOUT) if timeout elapsed, AVERROR_EXIT if stop() called,
+   * AVERROR(EINVAL) if demuxer not prepared or other negative AVERROR in case
+   * of error
+   */
+  FF_CPP_API int readPacket(Packet& packet) noexcept;
+
+  /**
+   * @brief Read and decode packets until next frame decoded by any of created
+   * decoders, packets of streams without decoder are skipped. On end of file
+   * decoders are flushed, so all frames are returned before AVERROR_EOF
+   *
+   * @param frame - frame to decode into, it is valid until next call
+   * @return 0 on success, AVERROR_EOF if end of file reached and all decoders
+   * flushed, AVERROR(ETIMEDOUT) if timeout elapsed, AVERROR_EXIT if stop()
+   * called, AVERROR(EINVAL) if demuxer not prepared or other negative AVERROR
+   * in case of demuxing/decoding error
+   */
+  FF_CPP_API int nextFrame(Frame& frame);
+
+  /**
+   * @brief Range over packets, see readPacket(). Iteration stops at end of
+   * file or on stop(), other errors are thrown as in start()
+   *
+   * @code
+   * for (auto& packet : demuxer.packets()) {...}
+   * @endcode
+   */
+  FF_CPP_API DemuxerRange<Packet> packets();
+
+  /**
+   * @brief Range over decoded frames, see nextFrame(). Iteration stops at end
+   * of file or on stop(), other errors are thrown as in start()
+   */
+  FF_CPP_API DemuxerRange<Frame> frames();
+
+  /**
+   * @brief Stop demuxing/decoding routine, could be called from any thread.
+   * Blocking ffmpeg call in progress (open input, read, seek) is interrupted
+   * immediately, prepare() throws Interrupted, start() returns, readPacket()
+   * and nextFrame() return AVERROR_EXIT until next prepare() or start()
    */
   FF_CPP_API void stop();
 
@@ -131,8 +548,229 @@ class Demuxer {
   Demuxer& operator=(const Demuxer&) = delete;
   Demuxer&& operator=(const Demuxer&&) = delete;
 
+  /**
+   * @brief Throw exception corresponding to error code of readPacket() or
+   * nextFrame()
+   */
+  [[noreturn]] FF_CPP_API void throwError(int err) const;
+
+  /**
+   * @brief prepare() and tryPrepare() requested when stop() was called stops
+   * times, stop() called after the request interrupts them
+   */
+  void prepare(const ParametersContainer& params, unsigned int timeout,
+               uint64_t stops);
+  Status tryPrepare(const ParametersContainer& params, unsigned int timeout,
+                    uint64_t stops) noexcept;
+
+  /**
+   * @brief Prepare state of start() routine
+   * @exception FFCppException if demuxer not prepared
+   * @return packet pool for the routine
+   */
+  FF_CPP_API PacketPool& beginStart();
+  /**
+   * @brief Return false if stop() called
+   */
+  FF_CPP_API bool running() const;
+  /**
+   * @brief Where packets of a stream go, table of routes is indexed by stream
+   * index and filled in prepare(), createDecoder(), onPacket() and onFrame()
+   */
+  struct StreamRoute {
+    Decoder* decoder{};
+    packet_callback onPacket;
+    frame_callback onFrame;
+  };
+
+  /**
+   * @brief Route of stream
+   *
+   * @return route or nullptr if stream appeared after prepare()
+   */
+  FF_CPP_API const StreamRoute* routeFor(int streamIndex) const;
+
+  /**
+   * @brief Pass reference to frame decoded by decoder of route to
+   * subscribers
+   */
+  FF_CPP_API void publish(const StreamRoute& route, Frame& frame);
+
+  /**
+   * @brief Switch demuxer to non blocking mode, readPacket() returns
+   * AVERROR(EAGAIN) if there is no data. Only custom input sources which
+   * implement IOSource::available() and devices which honor
+   * AVFMT_FLAG_NONBLOCK report it, reads of protocol inputs (file, tcp, udp,
+   * rtsp, http) block as usual
+   * @exception FFCppException if demuxer not prepared
+   */
+  FF_CPP_API void setNonBlocking(bool nonBlocking);
+
+  template <typename T>
+  friend class DemuxerRange;
+  friend class FrameCache;
+  friend class DemuxerPool;
+  FF_CPP_API friend std::vector<PrepareResult> prepareAll(
+      const std::vector<Demuxer*>& demuxers, size_t concurrency,
+      const ParametersContainer& params, unsigned int timeout);
+
   struct Impl;
   std::unique_ptr<Impl> impl_;
 };
 
+/**
+ * @brief Result of prepare() of one input by prepareAll()
+ */
+struct PrepareResult {
+  Demuxer* demuxer{};
+  /**
+   * @brief exception thrown by prepare() or nullptr on success
+   */
+  std::exception_ptr error;
+  /**
+   * @brief time spent waiting for free slot of bounded concurrency
+   */
+  std::chrono::microseconds queued{};
+  /**
+   * @brief time spent in prepare()
+   */
+  std::chrono::microseconds elapsed{};
+  /**
+   * @brief startup time of successful prepare(), see Demuxer::prepareStats()
+   */
+  PrepareStats stats;
+
+  bool ok() const { return !error; }
+};
+
+/**
+ * @brief Prepare many inputs in parallel, at most concurrency inputs are
+ * opened at the same time. Exceptions of prepare() are not thrown, they are
+ * reported in results, stop() of demuxer called after prepareAll() started
+ * cancels its prepare() in progress or queued one
+ *
+ * @param demuxers - demuxers to prepare, must not be used until function
+ * returns
+ * @param concurrency - max number of inputs opened at the same time, 0 means
+ * all at once
+ * @param params, timeout - passed to prepare() of each demuxer
+ * @return results in order of demuxers
+ */
+FF_CPP_API std::vector<PrepareResult> prepareAll(
+    const std::vector<Demuxer*>& demuxers, size_t concurrency = 32,
+    const ParametersContainer& params = {}, unsigned int timeout = 15);
+
+template <typename FrameFn, typename PacketFn>
+void Demuxer::start(FrameFn&& fc, PacketFn&& pc) {
+  auto status =
+      tryStart(std::forward<FrameFn>(fc), std::forward<PacketFn>(pc));
+  if (status.code() != StatusCode::Interrupted) {
+    status.throwIfError();
+  }
+}
+
+template <typename FrameFn, typename PacketFn>
+Status Demuxer::tryStart(FrameFn&& fc, PacketFn&& pc) {
+  auto& packetPool = beginStart();
+  Frame frame;
+
+  while (running()) {
+    Packet packet{packetPool};
+    if (auto err = readPacket(packet); err < 0) {
+      return Status::fromError(err);
+    }
+
+    auto route = routeFor(packet.streamIndex());
+    auto accepted =
+        route && route->onPacket ? route->onPacket(packet) : pc(packet);
+    if (!accepted || !route || !route->decoder) {
+      continue;
+    }
+
+    if (auto err = route->decoder->sendPacket(packet); err < 0) {
+      return Status::fromError(err);
+    }
+    while (true) {
+      auto err = route->decoder->receiveFrame(frame);
+      if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+        break;
+      } else if (err < 0) {
+        return Status::fromError(err);
+      }
+
+      publish(*route, frame);
+      if (route->onFrame) {
+        route->onFrame(frame);
+      } else {
+        fc(frame);
+      }
+    }
+  }
+  return Status{StatusCode::Interrupted, AVERROR_EXIT, "Demuxer stopped"};
+}
+
+/**
+ * @brief Single pass input range over packets or frames of Demuxer
+ */
+template <typename T>
+class DemuxerRange {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    iterator() = default;
+
+    T& operator*() const { return range_->item_; }
+    T* operator->() const { return &range_->item_; }
+
+    iterator& operator++() {
+      if (!range_->read()) {
+        range_ = nullptr;
+      }
+      return *this;
+    }
+
+    bool operator==(const iterator& other) const {
+      return range_ == other.range_;
+    }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+   private:
+    friend class DemuxerRange;
+    explicit iterator(DemuxerRange* range) : range_(range) { ++*this; }
+
+    DemuxerRange* range_{};
+  };
+
+  iterator begin() { return iterator{this}; }
+  iterator end() { return iterator{}; }
+
+ private:
+  friend class Demuxer;
+  using ReadFunction = int (Demuxer::*)(T&);
+
+  DemuxerRange(Demuxer& demuxer, ReadFunction read)
+      : demuxer_(demuxer), read_(read) {}
+
+  bool read() {
+    auto err = (demuxer_.*read_)(item_);
+    if (err == AVERROR_EOF || err == AVERROR_EXIT) {
+      return false;
+    }
+    if (err < 0) {
+      demuxer_.throwError(err);
+    }
+    return true;
+  }
+
+  Demuxer& demuxer_;
+  ReadFunction read_;
+  T item_;
+};
+
 }  // namespace ff_cpp
\ No newline at end of file
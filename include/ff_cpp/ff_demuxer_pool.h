@@ -0,0 +1,156 @@
+#pragma once
+#include <ff_cpp/ff_demuxer.h>
+#include <ff_cpp/ff_include.h>
+
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace ff_cpp {
+
+/**
+ * @brief Parameters of DemuxerPool
+ */
+struct DemuxerPoolOptions {
+  /**
+   * @brief number of worker threads, 0 means number of cores
+   */
+  unsigned int threads{};
+  /**
+   * @brief max number of packets read from input in one turn, then worker
+   * moves to next input, it bounds time other inputs wait for worker
+   */
+  size_t packetsPerTurn{8};
+  /**
+   * @brief delay before input without data is polled again, it is doubled
+   * each time input has no data up to maxBackoff
+   */
+  std::chrono::milliseconds minBackoff{1};
+  std::chrono::milliseconds maxBackoff{20};
+  /**
+   * @brief input which reports no data for this time is finished with
+   * TimeoutElapsed
+   */
+  std::chrono::milliseconds readTimeout{5000};
+};
+
+/**
+ * @brief Statistics of input of DemuxerPool
+ */
+struct PooledInputStats {
+  size_t id{};
+  Demuxer* demuxer{};
+  uint64_t packets{};
+  uint64_t frames{};
+  /**
+   * @brief number of times input was picked by worker
+   */
+  uint64_t turns{};
+  /**
+   * @brief number of polls which found no data
+   */
+  uint64_t wouldBlock{};
+  /**
+   * @brief time workers spent reading, decoding and in callbacks of input,
+   * share of input in pool throughput
+   */
+  std::chrono::microseconds busy{};
+  /**
+   * @brief delay between input became ready to be polled and worker picked
+   * it up
+   */
+  std::chrono::microseconds averageLag{};
+  std::chrono::microseconds maxLag{};
+  /**
+   * @brief true if input reached end of file, failed, was removed or pool
+   * stopped
+   */
+  bool finished{};
+  /**
+   * @brief exception input failed with or nullptr
+   */
+  std::exception_ptr error;
+};
+
+/**
+ * @brief DemuxerPool statistics
+ */
+struct DemuxerPoolStats {
+  std::vector<PooledInputStats> inputs;
+  /**
+   * @brief number of inputs taken by idle worker from queue of other worker
+   */
+  uint64_t steals{};
+};
+
+/**
+ * @brief Runs many demuxers on fixed set of worker threads instead of thread
+ * per Demuxer::start(). Inputs are read in non blocking mode, input without
+ * data is polled again after backoff, so one worker serves many live inputs.
+ * Each worker has its own queue of inputs, idle worker steals ready inputs
+ * from queues of other workers. Input is used by one worker at a time, its
+ * callbacks are never called concurrently
+ * @note only custom input sources which implement IOSource::available() and
+ * devices which honor AVFMT_FLAG_NONBLOCK report that they have no data.
+ * Protocol inputs (file, tcp, udp, rtsp, http) are read in blocking mode: a
+ * stalled network input holds its worker until data arrives or demuxer
+ * timeout (5 s) elapses, then the input is finished with TimeoutElapsed and
+ * readTimeout and backoff don't apply to it
+ * @note demuxers must outlive the pool or be removed from it
+ */
+class DemuxerPool {
+ public:
+  /**
+   * @brief DemuxerPool constructor, worker threads are started
+   */
+  FF_CPP_API explicit DemuxerPool(const DemuxerPoolOptions& options = {});
+  /**
+   * @brief Stop workers, see stop()
+   */
+  FF_CPP_API ~DemuxerPool();
+
+  /**
+   * @brief Add prepared demuxer to the pool, its packets and frames are
+   * dispatched as by Demuxer::start(), handlers registered by
+   * Demuxer::onPacket() and Demuxer::onFrame() are called as well. Input is
+   * finished on end of file after its decoders are flushed, on error or if
+   * Demuxer::stop() called
+   *
+   * @param fc - called for each decoded frame on worker thread
+   * @param pc - called for each packet on worker thread, nullptr means
+   * decode all packets
+   * @return id of input
+   * @exception FFCppException - if demuxer not prepared or pool stopped
+   */
+  FF_CPP_API size_t add(Demuxer& demuxer, frame_callback fc,
+                        packet_callback pc = nullptr);
+
+  /**
+   * @brief Remove input, wait until worker stops to use it, demuxer is
+   * switched back to blocking mode
+   * @exception FFCppException - if there is no input with such id
+   */
+  FF_CPP_API void remove(size_t id);
+
+  /**
+   * @brief Wait until all inputs finished
+   */
+  FF_CPP_API void wait();
+
+  /**
+   * @brief Stop and join workers, all inputs become finished
+   */
+  FF_CPP_API void stop();
+
+  FF_CPP_API DemuxerPoolStats stats() const;
+
+ private:
+  DemuxerPool(const DemuxerPool&) = delete;
+  DemuxerPool& operator=(const DemuxerPool&) = delete;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ff_cpp
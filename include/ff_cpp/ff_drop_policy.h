@@ -0,0 +1,33 @@
+#pragma once
+
+namespace ff_cpp {
+
+/**
+ * @brief What queue of pipelined routine does when it is full
+ */
+enum class DropPolicy {
+  /**
+   * @brief producer waits for free space, nothing is dropped, latency grows
+   * while consumer is slow
+   */
+  Block,
+  /**
+   * @brief oldest queued item is dropped to make room for new one
+   * @note dropped packets damage decoded frames until next keyframe
+   */
+  DropOldest,
+  /**
+   * @brief queued items are dropped, then new items are dropped until next
+   * keyframe, so decoding resumes from keyframe. Every frame counts as
+   * keyframe, so full frame queue is just cleared
+   */
+  DropUntilKeyframe,
+  /**
+   * @brief keyframe replaces all queued items, so frame queue holds only
+   * latest frame and packet queue holds packets of latest GOP. Full queue
+   * works as DropUntilKeyframe
+   */
+  KeepLatest
+};
+
+}  // namespace ff_cpp
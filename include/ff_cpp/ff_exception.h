@@ -63,4 +63,9 @@ class FilterError : public FFCppException {
   explicit FilterError(const std::string& msg) : FFCppException(msg) {}
 };
 
+class Interrupted : public FFCppException {
+ public:
+  explicit Interrupted(const std::string& msg) : FFCppException(msg) {}
+};
+
 }  // namespace ff_cpp
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <ff_cpp/ff_frame.h>
 #include <ff_cpp/ff_include.h>
+#include <ff_cpp/ff_status.h>
 
 #include <memory>
 
@@ -51,6 +52,35 @@ class Filter {
    * or unable to get filtered frame from sink
    */
   FF_CPP_API Frame filter(Frame& frm, bool keepRef = false);
+  /**
+   * @brief Filter input frame, if keepRef is true and input frame is not
+   * reference-counted, frame data is copied into buffer taken from pool
+   * instead of newly allocated one
+   * @note output frames are allocated by libavfilter which already reuses
+   * their buffers
+   *
+   * @param frm - input frame
+   * @param pool - pool for the copy of not reference-counted input frame
+   * @param keepRef - the same as for filter(Frame&, bool)
+   * @return filtered frame
+   * @throw ProcessingError - unable to add input frame to buffer filter,
+   * or unable to get filtered frame from sink
+   * @throw FFCppException - unable to copy input frame
+   */
+  FF_CPP_API Frame filter(Frame& frm, FramePool& pool, bool keepRef = false);
+  /**
+   * @brief Non throwing filter(Frame&, bool), filtered frame is written to
+   * out, so it could be reused for the next frame
+   *
+   * @param frm - input frame
+   * @param out - filtered frame, previous content is released
+   * @param keepRef - the same as for filter(Frame&, bool)
+   * @return StatusCode::ProcessingError if unable to add input frame to buffer
+   * filter or to get filtered frame from sink, StatusCode::TryAgain if filter
+   * needs more input frames to produce output one
+   */
+  FF_CPP_API Status tryFilter(Frame& frm, Frame& out,
+                              bool keepRef = false) noexcept;
 
   FF_CPP_API Filter& operator=(Filter&& other);
 
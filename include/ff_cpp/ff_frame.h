@@ -1,10 +1,41 @@
 #pragma once
 #include <ff_cpp/ff_include.h>
 
+#include <functional>
 #include <memory>
 
 namespace ff_cpp {
 
+class FramePool;
+
+/**
+ * @brief buffer_deleter will called to release buffer adopted by Frame
+ * @note must not throw
+ */
+using buffer_deleter = std::function<void(uint8_t*)>;
+
+/**
+ * @brief View of motion vectors exported by decoder, see
+ * DecoderOptions::exportMotionVectors. It is valid while frame it was taken
+ * from is not changed or destroyed
+ */
+class MotionVectors {
+ public:
+  MotionVectors() = default;
+  MotionVectors(const AVMotionVector* data, size_t size)
+      : data_(data), size_(size) {}
+
+  const AVMotionVector* begin() const { return data_; }
+  const AVMotionVector* end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const AVMotionVector& operator[](size_t i) const { return data_[i]; }
+
+ private:
+  const AVMotionVector* data_{};
+  size_t size_{};
+};
+
 //TODO add copyToBuffer function
 class Frame {
  public:
@@ -22,6 +53,19 @@ class Frame {
    * @throw FFCppException in case of wrong input params or in case of memory alloc failed
    */
   FF_CPP_API Frame(int width, int height, int format, int align = 1);
+  /**
+   * @brief Create frame and take image buffer from pool, buffer returns to the
+   * pool when last reference to it is released
+   *
+   * @param pool - buffer pool
+   * @param width - frame width
+   * @param height - frame height
+   * @param format - frame format
+   * @param align - the value to use for buffer size alignment
+   * @throw FFCppException in case of wrong input params or in case of memory alloc failed
+   */
+  FF_CPP_API Frame(FramePool& pool, int width, int height, int format,
+                   int align = 1);
   /**
    * @brief Create frame with input buffer with specified parameters
    * @note input buffer must exists until frame not destroyed
@@ -33,11 +77,53 @@ class Frame {
    * @param align - the value to use for buffer size alignment
    * @throw FFCppException in case of wrong input params or in case of memory alloc failed
    */
-  //TODO: add constructor with deleater that will take ownership of the ptr
   FF_CPP_API Frame(const uint8_t* ptr, int width, int height, int format, int align = 1);
+  /**
+   * @brief Create reference-counted frame which takes ownership of the input
+   * buffer, no data is copied. Deleter is called when frame and all references
+   * to it are destroyed, or if constructor throws
+   * 
+   * @param ptr - input buffer
+   * @param width - buffer width
+   * @param height - buffer height
+   * @param format - buffer format
+   * @param align - the value to use for buffer size alignment
+   * @param deleter - function to release the buffer
+   * @throw FFCppException in case of wrong input params or in case of memory alloc failed
+   */
+  FF_CPP_API Frame(uint8_t* ptr, int width, int height, int format, int align,
+                   buffer_deleter deleter);
+  /**
+   * @brief Create new reference to the other frame's data, pixel data is not
+   * copied if other frame is reference-counted, otherwise data is copied
+   * @throw FFCppException in case of memory alloc failed
+   */
+  FF_CPP_API Frame(const Frame& other);
   FF_CPP_API Frame(Frame&& other);
   FF_CPP_API ~Frame();
 
+  FF_CPP_API Frame& operator=(const Frame& other);
+  FF_CPP_API Frame& operator=(Frame&& other);
+
+  /**
+   * @brief Create new reference to the frame's data, the same as copy
+   * constructor. Returned frame stays valid after this frame reused or
+   * destroyed, so it could be passed to other thread
+   *
+   * @return new frame referencing the same data
+   * @throw FFCppException in case of memory alloc failed
+   */
+  FF_CPP_API Frame ref() const;
+  /**
+   * @brief Create deep copy of the frame, new image buffer is allocated and
+   * data copied
+   *
+   * @param align - the value to use for buffer size alignment
+   * @return new frame with own copy of data
+   * @throw FFCppException in case of memory alloc failed
+   */
+  FF_CPP_API Frame clone(int align = 1) const;
+
   FF_CPP_API int width() const;
   FF_CPP_API int height() const;
   FF_CPP_API int format() const;
@@ -65,6 +151,13 @@ class Frame {
    * @return FF_CPP_API* linesize 
    */
   FF_CPP_API int* linesize() const;
+  /**
+   * @brief Motion vectors side data (AV_FRAME_DATA_MOTION_VECTORS)
+   *
+   * @return empty view if decoder doesn't export motion vectors or frame has
+   * not any, for example keyframe
+   */
+  FF_CPP_API MotionVectors motionVectors() const;
 
   friend std::ostream& operator<<(std::ostream& ost, const Frame& frame);
 
@@ -74,7 +167,59 @@ class Frame {
 
   friend class Decoder;
   friend class Filter;
+  friend class FramePool;
   operator AVFrame*();
 };
 
+/**
+ * @brief Motion score of frame computed from its motion vectors: mean length
+ * of motion vectors in pixels, weighted by area of their blocks and
+ * normalized by frame area, or by total area of blocks if vectors of
+ * bi-predicted blocks cover more. Still scene gives score close to 0
+ *
+ * @return score or 0 if frame has not any motion vectors
+ */
+FF_CPP_API double motionScore(const Frame& frame);
+
+/**
+ * @brief FramePool statistics
+ */
+struct FramePoolStats {
+  /**
+   * @brief number of buffers reused from pool
+   */
+  uint64_t hits{};
+  /**
+   * @brief number of buffers allocated because pool was empty
+   */
+  uint64_t misses{};
+  /**
+   * @brief max number of buffers used at the same time, pools never free
+   * buffers so it is also number of buffers owned by pools
+   */
+  uint64_t peakBuffers{};
+};
+
+/**
+ * @brief Pool of image buffers based on AVBufferPool, separate AVBufferPool is
+ * created for each (width, height, format, align) combination. Pool is thread
+ * safe, buffers could outlive the pool
+ */
+class FramePool {
+ public:
+  FF_CPP_API FramePool();
+  FF_CPP_API ~FramePool();
+
+  FF_CPP_API FramePoolStats stats() const;
+
+ private:
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+  friend class Frame;
+};
+
 }  // namespace ff_cpp
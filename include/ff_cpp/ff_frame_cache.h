@@ -0,0 +1,94 @@
+#pragma once
+#include <ff_cpp/ff_demuxer.h>
+#include <ff_cpp/ff_frame.h>
+#include <ff_cpp/ff_include.h>
+
+#include <memory>
+
+namespace ff_cpp {
+
+/**
+ * @brief FrameCache statistics
+ */
+struct FrameCacheStats {
+  /**
+   * @brief frameAt() calls served from cache
+   */
+  uint64_t hits{};
+  /**
+   * @brief frameAt() calls which decoded GOP
+   */
+  uint64_t misses{};
+  /**
+   * @brief hits / (hits + misses)
+   */
+  double hitRate{};
+  /**
+   * @brief GOPs evicted to fit memory limit
+   */
+  uint64_t evictions{};
+  /**
+   * @brief number of cached GOPs
+   */
+  size_t gops{};
+  /**
+   * @brief number of cached frames
+   */
+  size_t frames{};
+  /**
+   * @brief memory used by image buffers of cached frames
+   */
+  size_t bytes{};
+};
+
+/**
+ * @brief Cache of decoded frames for scrubbing and repeated random access,
+ * keyed by stream and pts. GOPs are decoded and cached, least recently used
+ * GOPs are evicted when cache exceeds memory limit. GOP used last is never
+ * evicted and GOPs right before and after it are evicted after all others.
+ * Neighbouring GOPs are not prefetched, they are cached only if they were
+ * used
+ * @note cache uses demuxer and its decoders, so they must not be used by
+ * other code at the same time, demuxer must outlive the cache
+ */
+class FrameCache {
+ public:
+  /**
+   * @brief FrameCache constructor
+   *
+   * @param demuxer - prepared demuxer, decoders of streams must be created
+   * @param maxBytes - memory limit for image buffers of cached frames. If
+   * frames of one GOP don't fit the limit, only frames up to the requested
+   * one and after it which fit are kept, access to dropped frames of the GOP
+   * decodes it again. At least one frame is kept, so the limit is exceeded
+   * only if it is less than a frame
+   */
+  FF_CPP_API explicit FrameCache(Demuxer& demuxer,
+                                 size_t maxBytes = 512 * 1024 * 1024);
+  FF_CPP_API ~FrameCache();
+
+  /**
+   * @brief The same as Demuxer::frameAt(), but frame is taken from cache if
+   * its GOP was decoded before
+   *
+   * @return reference to cached frame, its data is shared with cache
+   * @exception see Demuxer::frameAt()
+   */
+  FF_CPP_API Frame frameAt(size_t streamIndex, int64_t pts);
+
+  /**
+   * @brief Drop all cached frames, statistics are kept
+   */
+  FF_CPP_API void clear();
+
+  FF_CPP_API FrameCacheStats stats() const;
+
+ private:
+  FrameCache(const FrameCache&) = delete;
+  FrameCache& operator=(const FrameCache&) = delete;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ff_cpp
@@ -0,0 +1,171 @@
+#pragma once
+#include <ff_cpp/ff_include.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace ff_cpp {
+
+/**
+ * @brief Custom input source for Demuxer, it is used through AVIOContext
+ * instead of protocols of libavformat. Methods are called from the thread
+ * which reads input (the one which calls Demuxer::prepare/start)
+ */
+class IOSource {
+ public:
+  virtual ~IOSource() = default;
+
+  /**
+   * @brief Read up to size bytes into buf
+   *
+   * @return number of read bytes, AVERROR_EOF if end of input reached or
+   * other negative AVERROR in case of error
+   */
+  virtual int read(uint8_t* buf, int size) = 0;
+  /**
+   * @brief Change read position
+   *
+   * @param offset - new position relative to whence
+   * @param whence - SEEK_SET, SEEK_CUR, SEEK_END or AVSEEK_SIZE
+   * @return new position, size of input in case of AVSEEK_SIZE or negative
+   * AVERROR if seek not supported
+   */
+  virtual int64_t seek(int64_t offset, int whence) = 0;
+  /**
+   * @brief Name of input, it is used as demuxer input source and as a hint
+   * for input format probing
+   */
+  virtual const std::string& name() const = 0;
+  /**
+   * @brief Number of bytes read() returns without blocking or -1 if unknown,
+   * for example for live input which receives data on other thread. Demuxer
+   * in non blocking mode (DemuxerPool) doesn't read input while there is no
+   * buffered data and it returns 0, packets already parsed by libavformat
+   * are returned after input has data again
+   * @note read() still could block if demuxer needs more bytes than are
+   * available to complete packet, so source should make data available in
+   * whole units of container (complete FLV tags, TS packets of whole PES)
+   * @note it is called by noexcept Demuxer::readPacket(), so it must not
+   * throw, report -1 instead
+   */
+  virtual int64_t available() const noexcept { return -1; }
+};
+
+/**
+ * @brief Input source reading directly from memory: a buffer owned by caller
+ * or memory mapped file
+ */
+class MemorySource : public IOSource {
+ public:
+  /**
+   * @brief Construct source over caller's buffer
+   * @note buffer must exists until source not destroyed
+   *
+   * @param data - input buffer
+   * @param size - buffer size
+   * @param name - name of input
+   */
+  FF_CPP_API MemorySource(const uint8_t* data, size_t size,
+                          const std::string& name = "memory");
+  /**
+   * @brief Construct source over memory mapped file
+   *
+   * @param path - path to the file
+   * @exception BadInput - if unable to open or map file
+   */
+  FF_CPP_API explicit MemorySource(const std::string& path);
+  FF_CPP_API ~MemorySource() override;
+
+  FF_CPP_API const uint8_t* data() const;
+  FF_CPP_API size_t size() const;
+
+  FF_CPP_API int read(uint8_t* buf, int size) override;
+  FF_CPP_API int64_t seek(int64_t offset, int whence) override;
+  FF_CPP_API const std::string& name() const override;
+
+ private:
+  MemorySource(const MemorySource&) = delete;
+  MemorySource& operator=(const MemorySource&) = delete;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+/**
+ * @brief Read-ahead window of PrefetchSource
+ */
+struct PrefetchOptions {
+  /**
+   * @brief size of one read request
+   */
+  size_t blockSize = 1024 * 1024;
+  /**
+   * @brief max number of blocks read ahead of current position
+   */
+  size_t windowBlocks = 8;
+};
+
+/**
+ * @brief PrefetchSource statistics
+ */
+struct PrefetchStats {
+  /**
+   * @brief bytes read from file by background thread
+   */
+  uint64_t bytesRead{};
+  /**
+   * @brief bytes passed to demuxer
+   */
+  uint64_t bytesConsumed{};
+  /**
+   * @brief number of demuxer reads which waited for background thread
+   */
+  uint64_t stalls{};
+  /**
+   * @brief total time demuxer waited for background thread
+   */
+  std::chrono::microseconds stallTime{};
+  /**
+   * @brief total time spent in file reads by background thread
+   */
+  std::chrono::microseconds readTime{};
+  /**
+   * @brief bytesRead / readTime, bytes per second
+   */
+  double readThroughput{};
+};
+
+/**
+ * @brief File input source which reads large blocks ahead of current
+ * position on a background thread, so demuxer doesn't wait for every small
+ * synchronous read. Useful for files on network file systems
+ */
+class PrefetchSource : public IOSource {
+ public:
+  /**
+   * @brief Open file and start read-ahead thread
+   *
+   * @param path - path to the file
+   * @param options - read-ahead window
+   * @exception BadInput - if unable to open file
+   */
+  FF_CPP_API explicit PrefetchSource(const std::string& path,
+                                     const PrefetchOptions& options = {});
+  FF_CPP_API ~PrefetchSource() override;
+
+  FF_CPP_API PrefetchStats stats() const;
+
+  FF_CPP_API int read(uint8_t* buf, int size) override;
+  FF_CPP_API int64_t seek(int64_t offset, int whence) override;
+  FF_CPP_API const std::string& name() const override;
+
+ private:
+  PrefetchSource(const PrefetchSource&) = delete;
+  PrefetchSource& operator=(const PrefetchSource&) = delete;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ff_cpp
@@ -5,9 +5,20 @@
 
 namespace ff_cpp {
 
+class PacketPool;
+
 class Packet {
  public:
   FF_CPP_API Packet();
+  /**
+   * @brief Take packet from pool, packet returns to the pool on destruction.
+   * If pool is exhausted packet is allocated as usual. Packet keeps memory of
+   * the pool alive, so it may outlive PacketPool object
+   *
+   * @param pool - pool to take packet from
+   */
+  FF_CPP_API explicit Packet(PacketPool& pool);
+  FF_CPP_API Packet(Packet&& other);
   FF_CPP_API ~Packet();
 
   /**
@@ -28,6 +39,10 @@ class Packet {
    * @return FF_CPP_API streamIndex 
    */
   FF_CPP_API int streamIndex() const;
+  /**
+   * @brief Return true if packet contains keyframe
+   */
+  FF_CPP_API bool isKeyframe() const;
 
   friend std::ostream& operator<<(std::ostream& ost, const Packet& pkt);
 
@@ -37,7 +52,43 @@ class Packet {
 
   friend class Demuxer;
   friend class Decoder;
+  friend class PacketPool;
   operator AVPacket*();
 };
 
+/**
+ * @brief Fixed size lock-free pool of packets. All packets are allocated once
+ * in constructor, taking and returning packet doesn't allocate memory, so
+ * pool could be used from any number of threads
+ */
+class PacketPool {
+ public:
+  /**
+   * @brief Construct a new Packet Pool object
+   *
+   * @param capacity - number of preallocated packets
+   * @throw FFCppException in case of memory alloc failed
+   */
+  FF_CPP_API explicit PacketPool(size_t capacity = 64);
+  FF_CPP_API ~PacketPool();
+
+  /**
+   * @brief Number of preallocated packets
+   */
+  FF_CPP_API size_t capacity() const;
+  /**
+   * @brief Number of packets which currently are in the pool
+   */
+  FF_CPP_API size_t available() const;
+
+ private:
+  PacketPool(const PacketPool&) = delete;
+  PacketPool& operator=(const PacketPool&) = delete;
+
+  struct Impl;
+  std::shared_ptr<Impl> impl_;
+
+  friend class Packet;
+};
+
 }  // namespace ff_cpp
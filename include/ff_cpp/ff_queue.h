@@ -0,0 +1,478 @@
+#pragma once
+#include <ff_cpp/ff_frame.h>
+#include <ff_cpp/ff_packet.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#include <emmintrin.h>
+#define FF_CPP_CPU_RELAX() _mm_pause()
+#else
+#define FF_CPP_CPU_RELAX() ((void)0)
+#endif
+
+namespace ff_cpp {
+
+/**
+ * @brief Size queue positions are padded to, so producers and consumers
+ * don't invalidate cache lines of each other
+ */
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief How SpscQueue and MpmcQueue wait while queue is full or empty
+ */
+enum class QueueWait {
+  /**
+   * @brief spin, then yield thread, lowest latency but thread occupies core
+   * while waiting
+   */
+  Spin,
+  /**
+   * @brief spin shortly, then sleep until other side notifies
+   */
+  Block
+};
+
+namespace detail {
+
+/**
+ * @brief Busy wait which backs off to yielding thread
+ */
+class SpinWait {
+ public:
+  static constexpr unsigned int SPIN_LIMIT = 64;
+
+  void wait() {
+    if (spins_ < SPIN_LIMIT) {
+      spins_++;
+      FF_CPP_CPU_RELAX();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  bool exhausted() const { return spins_ >= SPIN_LIMIT; }
+
+ private:
+  unsigned int spins_{};
+};
+
+/**
+ * @brief Parks blocked threads of lock-free queue. Mutex is locked only if
+ * someone waits, so queue operations stay lock-free while nobody blocks
+ */
+class QueueWaiter {
+ public:
+  /**
+   * @brief Sleep until ready() returns true, ready() is checked under mutex.
+   * Caller must recheck queue after return, wait is limited by RECHECK_PERIOD
+   * because position read by ready() could be stale when other consumer
+   * (producer) moved it
+   */
+  template <typename Ready>
+  void wait(Ready ready) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    waiters_.fetch_add(1, std::memory_order_relaxed);
+    // pairs with fence in notify(), either waiter sees new state of queue or
+    // notifier sees waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    condition_.wait_for(lock, RECHECK_PERIOD, ready);
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Wake waiters, must be called after state of queue changed
+   */
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0) {
+      // waiter holds mutex until it sleeps, so notification is not lost
+      { std::lock_guard<std::mutex> lg{mutex_}; }
+      condition_.notify_all();
+    }
+  }
+
+ private:
+  static constexpr std::chrono::milliseconds RECHECK_PERIOD{10};
+
+  std::atomic<size_t> waiters_{};
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
+inline size_t roundCapacity(size_t capacity) {
+  size_t rounded = 1;
+  while (rounded < capacity) {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+/**
+ * @brief Uninitialized storage of queued item
+ */
+template <typename T>
+struct Slot {
+  template <typename U>
+  void construct(U&& item) {
+    new (storage) T(std::forward<U>(item));
+  }
+
+  std::optional<T> take() {
+    auto item = std::launder(reinterpret_cast<T*>(storage));
+    std::optional<T> taken{std::move(*item)};
+    item->~T();
+    return taken;
+  }
+
+  alignas(T) unsigned char storage[sizeof(T)];
+};
+
+}  // namespace detail
+
+/**
+ * @brief Bounded lock-free queue of single producer and single consumer.
+ * Items are moved into ring of preallocated slots, so passing Packet or Frame
+ * handle doesn't allocate memory. Positions of producer and consumer are on
+ * separate cache lines, each side keeps cached copy of position of other side
+ * and rereads it only when queue looks full or empty
+ *
+ * @note push functions must be called from one thread and pop functions from
+ * one thread
+ */
+template <typename T>
+class SpscQueue {
+ public:
+  /**
+   * @param capacity - max number of queued items, rounded up to power of 2
+   */
+  explicit SpscQueue(size_t capacity)
+      : mask_(detail::roundCapacity(capacity) - 1),
+        slots_(std::make_unique<detail::Slot<T>[]>(mask_ + 1)) {}
+  ~SpscQueue() {
+    while (tryPop()) {
+    }
+  }
+
+  /**
+   * @brief Push item if there is free slot
+   * @return false if queue full or closed, item is not moved in that case
+   */
+  bool tryPush(T&& item) {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cachedHead_ > mask_) {
+      cachedHead_ = head_.load(std::memory_order_acquire);
+      if (tail - cachedHead_ > mask_) {
+        return false;
+      }
+    }
+    if (closed()) {
+      return false;
+    }
+    slots_[tail & mask_].construct(std::move(item));
+    tail_.store(tail + 1, std::memory_order_release);
+    notEmpty_.notify();
+    return true;
+  }
+
+  /**
+   * @brief Pop item if there is one
+   */
+  std::optional<T> tryPop() {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == cachedTail_) {
+      cachedTail_ = tail_.load(std::memory_order_acquire);
+      if (head == cachedTail_) {
+        return std::nullopt;
+      }
+    }
+    auto item = slots_[head & mask_].take();
+    head_.store(head + 1, std::memory_order_release);
+    notFull_.notify();
+    return item;
+  }
+
+  /**
+   * @brief Push item, wait while queue is full
+   * @return false if queue closed, item is not moved in that case
+   */
+  bool push(T&& item, QueueWait wait = QueueWait::Block) {
+    detail::SpinWait spin;
+    while (!tryPush(std::move(item))) {
+      if (closed()) {
+        return false;
+      }
+      if (wait == QueueWait::Block && spin.exhausted()) {
+        notFull_.wait([this] { return writable() || closed(); });
+      } else {
+        spin.wait();
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Pop item, wait while queue is empty
+   * @return std::nullopt if queue closed and there is no more items
+   */
+  std::optional<T> pop(QueueWait wait = QueueWait::Block) {
+    detail::SpinWait spin;
+    while (true) {
+      if (auto item = tryPop()) {
+        return item;
+      }
+      if (closed() && !readable()) {
+        return std::nullopt;
+      }
+      if (wait == QueueWait::Block && spin.exhausted()) {
+        notEmpty_.wait([this] { return readable() || closed(); });
+      } else {
+        spin.wait();
+      }
+    }
+  }
+
+  /**
+   * @brief Reject further pushes and wake waiting threads, queued items still
+   * could be popped
+   */
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    notEmpty_.notify();
+    notFull_.notify();
+  }
+
+  bool closed() const { return closed_.load(std::memory_order_acquire); }
+  size_t capacity() const { return mask_ + 1; }
+  /**
+   * @brief Number of queued items, approximate while queue is used
+   */
+  size_t size() const {
+    // head never passes tail, so head is read first
+    const auto head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+ private:
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  bool readable() const {
+    return tail_.load(std::memory_order_acquire) !=
+           head_.load(std::memory_order_relaxed);
+  }
+  bool writable() const {
+    return tail_.load(std::memory_order_relaxed) -
+               head_.load(std::memory_order_acquire) <=
+           mask_;
+  }
+
+  // written by consumer
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{};
+  size_t cachedTail_{};
+  // written by producer
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{};
+  size_t cachedHead_{};
+
+  alignas(CACHE_LINE_SIZE) const size_t mask_;
+  const std::unique_ptr<detail::Slot<T>[]> slots_;
+  std::atomic<bool> closed_{};
+  detail::QueueWaiter notEmpty_;
+  detail::QueueWaiter notFull_;
+};
+
+/**
+ * @brief Bounded lock-free queue of many producers and many consumers. Each
+ * slot of ring has sequence number telling whether it is free or holds item
+ * for current lap, producers and consumers claim slots by advancing their
+ * positions with compare and swap, so slow thread doesn't block others
+ * between claim and publishing of its slot
+ */
+template <typename T>
+class MpmcQueue {
+ public:
+  /**
+   * @param capacity - max number of queued items, rounded up to power of 2
+   */
+  explicit MpmcQueue(size_t capacity)
+      : mask_(detail::roundCapacity(capacity) - 1),
+        cells_(std::make_unique<Cell[]>(mask_ + 1)) {
+    for (size_t i = 0; i <= mask_; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  ~MpmcQueue() {
+    while (tryPop()) {
+    }
+  }
+
+  /**
+   * @brief Push item if there is free slot
+   * @return false if queue full or closed, item is not moved in that case
+   */
+  bool tryPush(T&& item) {
+    if (closed()) {
+      return false;
+    }
+    auto pos = enqueuePos_.load(std::memory_order_relaxed);
+    Cell* cell{};
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const auto seq = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // slot still holds item of previous lap
+        return false;
+      } else {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->slot.construct(std::move(item));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    notEmpty_.notify();
+    return true;
+  }
+
+  /**
+   * @brief Pop item if there is one
+   */
+  std::optional<T> tryPop() {
+    auto pos = dequeuePos_.load(std::memory_order_relaxed);
+    Cell* cell{};
+    while (true) {
+      cell = &cells_[pos & mask_];
+      const auto seq = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return std::nullopt;
+      } else {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    auto item = cell->slot.take();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    notFull_.notify();
+    return item;
+  }
+
+  /**
+   * @brief Push item, wait while queue is full
+   * @return false if queue closed, item is not moved in that case
+   */
+  bool push(T&& item, QueueWait wait = QueueWait::Block) {
+    detail::SpinWait spin;
+    while (!tryPush(std::move(item))) {
+      if (closed()) {
+        return false;
+      }
+      if (wait == QueueWait::Block && spin.exhausted()) {
+        notFull_.wait([this] { return writable() || closed(); });
+      } else {
+        spin.wait();
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Pop item, wait while queue is empty
+   * @return std::nullopt if queue closed and there is no more items
+   * @note item pushed concurrently with close() could be left in queue
+   */
+  std::optional<T> pop(QueueWait wait = QueueWait::Block) {
+    detail::SpinWait spin;
+    while (true) {
+      if (auto item = tryPop()) {
+        return item;
+      }
+      if (closed() && !readable()) {
+        return std::nullopt;
+      }
+      if (wait == QueueWait::Block && spin.exhausted()) {
+        notEmpty_.wait([this] { return readable() || closed(); });
+      } else {
+        spin.wait();
+      }
+    }
+  }
+
+  /**
+   * @brief Reject further pushes and wake waiting threads, queued items still
+   * could be popped
+   */
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    notEmpty_.notify();
+    notFull_.notify();
+  }
+
+  bool closed() const { return closed_.load(std::memory_order_acquire); }
+  size_t capacity() const { return mask_ + 1; }
+  /**
+   * @brief Number of queued items, approximate while queue is used
+   */
+  size_t size() const {
+    const auto dequeued = dequeuePos_.load(std::memory_order_acquire);
+    const auto enqueued = enqueuePos_.load(std::memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+ private:
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  struct Cell {
+    std::atomic<size_t> sequence{};
+    detail::Slot<T> slot;
+  };
+
+  bool readable() const {
+    const auto pos = dequeuePos_.load(std::memory_order_relaxed);
+    return cells_[pos & mask_].sequence.load(std::memory_order_acquire) ==
+           pos + 1;
+  }
+  bool writable() const {
+    const auto pos = enqueuePos_.load(std::memory_order_relaxed);
+    return cells_[pos & mask_].sequence.load(std::memory_order_acquire) ==
+           pos;
+  }
+
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePos_{};
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeuePos_{};
+
+  alignas(CACHE_LINE_SIZE) const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  std::atomic<bool> closed_{};
+  detail::QueueWaiter notEmpty_;
+  detail::QueueWaiter notFull_;
+};
+
+using PacketSpscQueue = SpscQueue<Packet>;
+using FrameSpscQueue = SpscQueue<Frame>;
+using PacketMpmcQueue = MpmcQueue<Packet>;
+using FrameMpmcQueue = MpmcQueue<Frame>;
+
+}  // namespace ff_cpp
+
+#undef FF_CPP_CPU_RELAX
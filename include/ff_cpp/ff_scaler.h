@@ -30,6 +30,18 @@ class Scaler {
    * @exception FFCppException - in case of no ability to scale or if input args wrong
    */
   FF_CPP_API ff_cpp::Frame scale(ff_cpp::Frame& srcFrame, int dstAlignment);
+  /**
+   * @brief Scale source frame and return new scaled frame, image buffer of
+   * returned frame is taken from pool
+   * 
+   * @param srcFrame - source frame
+   * @param dstAlignment - alignment for returned frame
+   * @param pool - pool to take image buffer from
+   * @return new ff_cpp::Frame
+   * @exception FFCppException - in case of no ability to scale or if input args wrong
+   */
+  FF_CPP_API ff_cpp::Frame scale(ff_cpp::Frame& srcFrame, int dstAlignment,
+                                 ff_cpp::FramePool& pool);
   /**
    * @brief Scale source frame into destination frame
    * 
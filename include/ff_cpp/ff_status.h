@@ -0,0 +1,82 @@
+#pragma once
+#include <ff_cpp/ff_include.h>
+
+#include <string>
+
+namespace ff_cpp {
+
+/**
+ * @brief Outcome of non throwing functions, each failure corresponds to
+ * exception thrown by throwing alternative of the function
+ */
+enum class StatusCode {
+  Ok,
+  /**
+   * @brief FFCppException
+   */
+  Error,
+  TimeoutElapsed,
+  BadInput,
+  OptionsNotAccepted,
+  NoStream,
+  ProcessingError,
+  EndOfFile,
+  FilterError,
+  Interrupted,
+  /**
+   * @brief more input required before output is available, AVERROR(EAGAIN),
+   * throwing functions report it as ProcessingError
+   */
+  TryAgain
+};
+
+/**
+ * @brief Expected-style result of non throwing functions like
+ * Demuxer::tryPrepare(), Demuxer::tryStart() and Filter::tryFilter().
+ * Creating status doesn't allocate, description of failed operation is a
+ * static string and text of AVERROR is built only by message()
+ */
+class Status {
+ public:
+  Status() = default;
+  /**
+   * @param error - AVERROR status originates from or 0
+   * @param what - description of failed operation or nullptr, pointer is
+   * kept, so it must be a string literal
+   */
+  constexpr Status(StatusCode code, int error = 0,
+                   const char* what = nullptr) noexcept
+      : code_(code), error_(error), what_(what) {}
+
+  /**
+   * @brief Status of AVERROR returned by Demuxer::readPacket(),
+   * Demuxer::nextFrame(), Decoder::sendPacket() or Decoder::receiveFrame(),
+   * codes are mapped as Demuxer::start() maps them to exceptions
+   */
+  FF_CPP_API static Status fromError(int error) noexcept;
+
+  bool ok() const noexcept { return code_ == StatusCode::Ok; }
+  explicit operator bool() const noexcept { return ok(); }
+  StatusCode code() const noexcept { return code_; }
+  int error() const noexcept { return error_; }
+  const char* what() const noexcept { return what_; }
+
+  /**
+   * @brief Description of failed operation followed by text of AVERROR
+   */
+  FF_CPP_API std::string message() const;
+
+  /**
+   * @brief Throw exception corresponding to code, do nothing if status is
+   * ok. BadInput is thrown with empty url and OptionsNotAccepted with empty
+   * options, functions which know them throw these exceptions themselves
+   */
+  FF_CPP_API void throwIfError() const;
+
+ private:
+  StatusCode code_{StatusCode::Ok};
+  int error_{};
+  const char* what_{};
+};
+
+}  // namespace ff_cpp
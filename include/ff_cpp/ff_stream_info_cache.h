@@ -0,0 +1,82 @@
+#pragma once
+#include <ff_cpp/ff_include.h>
+
+#include <memory>
+#include <string>
+
+namespace ff_cpp {
+
+/**
+ * @brief How Demuxer::prepare() uses cached stream parameters
+ */
+enum class StartupProbe {
+  /**
+   * @brief don't probe input (avformat_find_stream_info) if streams opened
+   * by demuxer match cached ones, parameters are taken from cache
+   */
+  Skip,
+  /**
+   * @brief probe input with minimal probesize and analyzeduration, then
+   * complete parameters from cache. If streams don't match cached ones, input
+   * is probed again with original probesize and analyzeduration and cache is
+   * updated
+   */
+  Minimal
+};
+
+/**
+ * @brief Cache of probed stream parameters per input: codec parameters,
+ * stream layout and frame rates. It is filled by Demuxer::prepare() after
+ * full probing and used by next prepare() of the same input to start fast.
+ * Cache is thread safe, so it could be shared by all demuxers
+ */
+class StreamInfoCache {
+ public:
+  FF_CPP_API StreamInfoCache();
+  FF_CPP_API ~StreamInfoCache();
+
+  /**
+   * @brief Return true if there are parameters of input
+   */
+  FF_CPP_API bool contains(const std::string& input) const;
+  /**
+   * @brief Drop parameters of input, for example after camera was
+   * reconfigured
+   */
+  FF_CPP_API void erase(const std::string& input);
+  FF_CPP_API void clear();
+  FF_CPP_API size_t size() const;
+
+  /**
+   * @brief Save cache to text file
+   * @exception FFCppException - if unable to write file
+   */
+  FF_CPP_API void save(const std::string& path) const;
+  /**
+   * @brief Load cache saved by save(), loaded inputs replace existing ones
+   * @exception BadInput - if unable to read file or file malformed
+   */
+  FF_CPP_API void load(const std::string& path);
+
+ private:
+  StreamInfoCache(const StreamInfoCache&) = delete;
+  StreamInfoCache& operator=(const StreamInfoCache&) = delete;
+
+  friend class Demuxer;
+  /**
+   * @brief Remember parameters of all streams of probed input
+   */
+  void store(const std::string& input, const AVFormatContext* context);
+  /**
+   * @brief Copy cached parameters to streams of opened input
+   *
+   * @return false if there is no input in cache or its streams don't match
+   * cached ones, streams are not changed in that case
+   */
+  bool apply(const std::string& input, AVFormatContext* context) const;
+
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace ff_cpp
@@ -0,0 +1,258 @@
+#include <ff_cpp/ff_batch_decoder.h>
+#include <ff_cpp/ff_exception.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "ff_blocking_queue.h"
+
+namespace ff_cpp {
+
+namespace {
+
+/**
+ * @brief Packets with decoding timestamps in [start, end) of one stream
+ */
+struct Range {
+  int64_t start{};
+  int64_t end{};
+};
+
+/**
+ * @brief State shared between decoding threads and the calling thread
+ */
+struct BatchState {
+  std::vector<Range> ranges;
+  std::atomic<size_t> nextRange{};
+  // ordered delivery uses queue per range, unordered one common queue
+  std::vector<std::unique_ptr<BlockingQueue<Frame>>> frames;
+  std::atomic<size_t> producers{};
+  std::atomic<bool> aborted{};
+
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  void setError(std::exception_ptr err) {
+    std::lock_guard<std::mutex> lg{errorMutex};
+    if (!error) {
+      error = err;
+    }
+  }
+
+  void abort() {
+    aborted = true;
+    for (auto& queue : frames) {
+      queue->abort();
+    }
+  }
+
+  BlockingQueue<Frame>& queueFor(size_t range) {
+    return frames.size() == 1 ? *frames.front() : *frames[range];
+  }
+};
+
+void throwReadError(int err) {
+  if (err == AVERROR(ETIMEDOUT)) {
+    throw TimeoutElapsed("Timeout elapsed while read frame");
+  }
+  throw ProcessingError(av_err2str(err));
+}
+
+}  // namespace
+
+struct BatchDecoder::Impl {
+  std::string input;
+  std::string inputFormat;
+  std::atomic<bool> doWork{};
+
+  // state of running decode(), stop() aborts its queues, so the calling
+  // thread doesn't wait for range no worker is going to decode
+  std::mutex stateMutex;
+  BatchState* state{};
+
+  void setState(BatchState* batchState) {
+    std::lock_guard<std::mutex> lg{stateMutex};
+    state = batchState;
+    if (state && !doWork) {
+      state->abort();
+    }
+  }
+};
+
+BatchDecoder::BatchDecoder(const std::string& inputSource,
+                           const std::string& inputFormat) {
+  impl_ = std::make_unique<Impl>();
+  impl_->input = inputSource;
+  impl_->inputFormat = inputFormat;
+}
+
+BatchDecoder::~BatchDecoder() {}
+
+void BatchDecoder::decode(frame_callback fc, const BatchOptions& options) {
+  impl_->doWork = true;
+
+  KeyframeIndex index;
+  {
+    Demuxer demuxer{impl_->input, impl_->inputFormat};
+    demuxer.prepare();
+    auto streamIndex = options.streamIndex >= 0
+                           ? static_cast<size_t>(options.streamIndex)
+                           : demuxer.bestVideoStream().index();
+    index = demuxer.keyframeIndex(streamIndex);
+  }
+
+  BatchState state;
+  const auto gopsPerRange = std::max<size_t>(options.gopsPerRange, 1);
+  for (size_t i = 0; i < index.timestamps.size(); i += gopsPerRange) {
+    auto next = i + gopsPerRange;
+    state.ranges.push_back(
+        Range{index.timestamps[i], next < index.timestamps.size()
+                                       ? index.timestamps[next]
+                                       : std::numeric_limits<int64_t>::max()});
+  }
+  if (state.ranges.empty()) {
+    // nothing to split by, whole stream is decoded by one thread
+    state.ranges.push_back(Range{std::numeric_limits<int64_t>::min(),
+                                 std::numeric_limits<int64_t>::max()});
+  }
+
+  auto threads = options.threads
+                     ? options.threads
+                     : std::max(std::thread::hardware_concurrency(), 1u);
+  threads = std::min(threads, state.ranges.size());
+  const auto framesPerThread = std::max<size_t>(options.framesPerThread, 1);
+  if (options.ordered) {
+    for (size_t i = 0; i < state.ranges.size(); i++) {
+      state.frames.push_back(
+          std::make_unique<BlockingQueue<Frame>>(framesPerThread));
+    }
+  } else {
+    state.frames.push_back(
+        std::make_unique<BlockingQueue<Frame>>(threads * framesPerThread));
+  }
+  state.producers = threads;
+
+  auto worker = [this, &state, &index, &options]() {
+    try {
+      Demuxer demuxer{impl_->input, impl_->inputFormat};
+      demuxer.prepare();
+      demuxer.selectStreams({static_cast<size_t>(index.streamIndex)});
+      auto& decoder = demuxer.createDecoder(index.streamIndex, AV_CODEC_ID_NONE,
+                                            options.decoderOptions);
+
+      // return false if frames queue closed
+      auto decode = [&decoder](Packet& packet, BlockingQueue<Frame>& frames) {
+        if (auto err = decoder.sendPacket(packet); err < EXIT_SUCCESS) {
+          throw ProcessingError(av_err2str(err));
+        }
+        while (true) {
+          Frame frame;
+          auto err = decoder.receiveFrame(frame);
+          if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+            return true;
+          } else if (err < EXIT_SUCCESS) {
+            throw ProcessingError(av_err2str(err));
+          }
+          if (!frames.push(std::move(frame))) {
+            return false;
+          }
+        }
+      };
+
+      Packet packet;
+      while (impl_->doWork && !state.aborted) {
+        const auto rangeIndex = state.nextRange++;
+        if (rangeIndex >= state.ranges.size()) {
+          break;
+        }
+        const auto& range = state.ranges[rangeIndex];
+        auto& frames = state.queueFor(rangeIndex);
+        if (range.start != std::numeric_limits<int64_t>::min()) {
+          demuxer.seek(range.start, AVSEEK_FLAG_BACKWARD, index.streamIndex);
+        }
+
+        auto delivering = true;
+        while (delivering && impl_->doWork) {
+          auto err = demuxer.readPacket(packet);
+          if (err == AVERROR_EOF) {
+            break;
+          } else if (err < EXIT_SUCCESS) {
+            throwReadError(err);
+          }
+          if (packet.streamIndex() != index.streamIndex) {
+            continue;
+          }
+          auto timestamp =
+              packet.dts() != AV_NOPTS_VALUE ? packet.dts() : packet.pts();
+          if (timestamp != AV_NOPTS_VALUE) {
+            if (timestamp >= range.end) {
+              break;
+            }
+            if (timestamp < range.start) {
+              continue;
+            }
+          }
+          delivering = decode(packet, frames);
+        }
+
+        // empty packet puts decoder into draining mode, next seek flushes it
+        Packet flushPacket;
+        if (delivering) {
+          decode(flushPacket, frames);
+        }
+        if (options.ordered) {
+          frames.close();
+        }
+      }
+    } catch (...) {
+      state.setError(std::current_exception());
+      state.abort();
+    }
+    if (--state.producers == 0 && !options.ordered) {
+      state.frames.front()->close();
+    }
+  };
+
+  impl_->setState(&state);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(worker);
+  }
+
+  try {
+    for (size_t i = 0; i < state.frames.size() && impl_->doWork; i++) {
+      while (auto frame = state.frames[i]->pop()) {
+        if (!impl_->doWork) {
+          break;
+        }
+        fc(*frame);
+      }
+    }
+  } catch (...) {
+    state.setError(std::current_exception());
+  }
+
+  state.abort();
+  for (auto& thread : workers) {
+    thread.join();
+  }
+  impl_->setState(nullptr);
+
+  if (state.error) {
+    std::rethrow_exception(state.error);
+  }
+}
+
+void BatchDecoder::stop() {
+  std::lock_guard<std::mutex> lg{impl_->stateMutex};
+  impl_->doWork = false;
+  if (impl_->state) {
+    impl_->state->abort();
+  }
+}
+
+}  // namespace ff_cpp
@@ -0,0 +1,140 @@
+#pragma once
+#include <ff_cpp/ff_drop_policy.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace ff_cpp {
+
+/**
+ * @brief Bounded queue used to pass packets and frames between pipeline
+ * threads, it blocks or drops items when full according to DropPolicy
+ */
+template <typename T>
+class BlockingQueue {
+ public:
+  /**
+   * @param dropped - counter of dropped items, could be nullptr
+   */
+  explicit BlockingQueue(size_t capacity, DropPolicy policy = DropPolicy::Block,
+                         std::atomic<uint64_t>* dropped = nullptr)
+      : capacity_(capacity ? capacity : 1),
+        policy_(policy),
+        dropped_(dropped) {}
+
+  /**
+   * @brief Push item, block or drop items while queue is full
+   *
+   * @param key - decoding could be resumed from item, see DropPolicy
+   * @return false if queue closed, item is dropped in that case
+   */
+  bool push(T&& item, bool key = true) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (policy_ == DropPolicy::Block) {
+      notFull_.wait(lock,
+                    [this] { return closed_ || items_.size() < capacity_; });
+    }
+    if (closed_) {
+      return false;
+    }
+
+    switch (policy_) {
+      case DropPolicy::Block:
+        break;
+      case DropPolicy::DropOldest:
+        if (items_.size() >= capacity_) {
+          items_.pop_front();
+          drop(1);
+        }
+        break;
+      case DropPolicy::KeepLatest:
+        if (key) {
+          dropAll();
+          waitingKey_ = false;
+          break;
+        }
+        [[fallthrough]];
+      case DropPolicy::DropUntilKeyframe:
+        if (items_.size() >= capacity_) {
+          dropAll();
+          waitingKey_ = true;
+        }
+        if (waitingKey_ && !key) {
+          drop(1);
+          return true;
+        }
+        waitingKey_ = false;
+        break;
+    }
+    items_.push_back(std::move(item));
+    notEmpty_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Pop item, block while queue is empty
+   *
+   * @return std::nullopt if queue closed and there is no more items
+   */
+  std::optional<T> pop() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    std::optional<T> item{std::move(items_.front())};
+    items_.pop_front();
+    notFull_.notify_one();
+    return item;
+  }
+
+  /**
+   * @brief Reject further pushes, queued items still could be popped
+   */
+  void close() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    closed_ = true;
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+  }
+
+  /**
+   * @brief Close queue and drop all queued items
+   */
+  void abort() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    closed_ = true;
+    items_.clear();
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+  }
+
+ private:
+  void drop(size_t count) {
+    if (dropped_) {
+      *dropped_ += count;
+    }
+  }
+
+  void dropAll() {
+    drop(items_.size());
+    items_.clear();
+  }
+
+  const size_t capacity_;
+  const DropPolicy policy_;
+  std::atomic<uint64_t>* const dropped_;
+  bool waitingKey_{};
+  bool closed_{};
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+};
+
+}  // namespace ff_cpp
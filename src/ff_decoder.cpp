@@ -1,7 +1,11 @@
 #include <ff_cpp/ff_decoder.h>
 #include <ff_cpp/ff_exception.h>
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <ostream>
+#include <thread>
 
 namespace ff_cpp {
 
@@ -13,12 +17,123 @@ static void avCodecDeleter(AVCodecContext* ctxt) {
 using UniqCodecContext =
     std::unique_ptr<AVCodecContext, decltype(avCodecDeleter)*>;
 
+/**
+ * @brief Process-wide decode thread budget and number of live decoders
+ * sharing it
+ */
+class ThreadBudget {
+ public:
+  static ThreadBudget& instance() {
+    static ThreadBudget budget;
+    return budget;
+  }
+
+  void set(const DecodeThreadBudget& budget) {
+    std::lock_guard<std::mutex> lg{mutex_};
+    budget_ = budget;
+  }
+
+  DecodeThreadBudget get() {
+    std::lock_guard<std::mutex> lg{mutex_};
+    return budget_;
+  }
+
+  /**
+   * @brief Take fair share of budget for decoder being opened, share is
+   * computed and taken under one lock
+   *
+   * @return number of threads, they must be returned by release()
+   */
+  int acquire() {
+    std::lock_guard<std::mutex> lg{mutex_};
+    unsigned int threads = budget_.threads;
+    if (!threads) {
+      threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    auto decoders = std::max(budget_.decoders, live_ + 1);
+    auto left = threads > used_ ? threads - used_ : 0u;
+    auto share = std::max(std::min(threads / decoders, left), 1u);
+    live_++;
+    used_ += share;
+    return static_cast<int>(share);
+  }
+
+  void release(int threads) {
+    std::lock_guard<std::mutex> lg{mutex_};
+    live_--;
+    used_ -= static_cast<unsigned int>(threads);
+  }
+
+ private:
+  std::mutex mutex_;
+  DecodeThreadBudget budget_;
+  // number of live decoders sharing budget and threads they took
+  unsigned int live_{};
+  unsigned int used_{};
+};
+
+void setDecodeThreadBudget(const DecodeThreadBudget& budget) {
+  ThreadBudget::instance().set(budget);
+}
+
+DecodeThreadBudget decodeThreadBudget() {
+  return ThreadBudget::instance().get();
+}
+
 struct Decoder::Impl {
+  ~Impl() {
+    if (budgetThreads) {
+      ThreadBudget::instance().release(budgetThreads);
+    }
+  }
+
   UniqCodecContext decoderContext{nullptr, avCodecDeleter};
+  // threads taken from process-wide budget
+  int budgetThreads{};
+
+  DecodeMode mode{DecodeMode::All};
+  // TargetFps mode, in seconds
+  double interval{};
+  double nextDue{};
+  bool nextDueSet{};
+  // read by stats() while decode thread updates them
+  std::atomic<uint64_t> decoded{};
+  std::atomic<uint64_t> skipped{};
+
+  double seconds(int64_t timestamp) const {
+    return timestamp * av_q2d(decoderContext->pkt_timebase);
+  }
+
+  bool timeBaseKnown() const {
+    return decoderContext->pkt_timebase.num > 0 &&
+           decoderContext->pkt_timebase.den > 0;
+  }
+
+  bool due(int64_t timestamp) const {
+    return !nextDueSet || timestamp == AV_NOPTS_VALUE ||
+           seconds(timestamp) >= nextDue;
+  }
+
+  /**
+   * @brief next frame is due one interval after current due time, or after
+   * frame time if input jumped forward
+   */
+  void frameDelivered(int64_t timestamp) {
+    if (timestamp == AV_NOPTS_VALUE) {
+      return;
+    }
+    auto time = seconds(timestamp);
+    nextDue = nextDueSet ? nextDue + interval : time + interval;
+    if (nextDue <= time) {
+      nextDue = time + interval;
+    }
+    nextDueSet = true;
+  }
 };
 
 Decoder::Decoder(AVCodecID codecId, AVCodecParameters* codecpar,
-                 const ParametersContainer& userParams) {
+                 const ParametersContainer& userParams,
+                 const DecoderOptions& options) {
   impl_ = std::make_unique<Impl>();
   auto decoder = avcodec_find_decoder(codecId);
   if (!decoder) {
@@ -44,6 +159,36 @@ Decoder::Decoder(AVCodecID codecId, AVCodecParameters* codecpar,
     }
   }
 
+  impl_->mode = options.mode;
+  if (impl_->mode == DecodeMode::TargetFps) {
+    impl_->interval = options.targetFps > 0 ? 1 / options.targetFps : 0;
+  } else if (impl_->mode == DecodeMode::KeyframesOnly) {
+    impl_->decoderContext->skip_frame = AVDISCARD_NONKEY;
+  }
+
+  auto context = impl_->decoderContext.get();
+  if (options.speed != DecodeSpeed::Exact) {
+    context->flags2 |= AV_CODEC_FLAG2_FAST;
+  }
+  if (options.exportMotionVectors) {
+    context->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+  }
+  if (options.speed == DecodeSpeed::Fast) {
+    context->skip_loop_filter = AVDISCARD_NONREF;
+  } else if (options.speed == DecodeSpeed::Fastest) {
+    context->skip_loop_filter = AVDISCARD_ALL;
+    context->skip_idct = AVDISCARD_BIDIR;
+    context->lowres = std::min<int>(1, decoder->max_lowres);
+  }
+
+  impl_->decoderContext->thread_type = options.threadType;
+  if (options.shareThreadBudget) {
+    impl_->budgetThreads = ThreadBudget::instance().acquire();
+    impl_->decoderContext->thread_count = impl_->budgetThreads;
+  } else if (options.threadCount > 0) {
+    impl_->decoderContext->thread_count = options.threadCount;
+  }
+
   AVDictionary* optionsDict{};
   for (const auto& param : userParams) {
     av_dict_set(&optionsDict, param.first.c_str(), param.second.c_str(), 0);
@@ -81,12 +226,74 @@ FF_CPP_API int Decoder::format() const {
   return impl_->decoderContext->pix_fmt;
 }
 
-int Decoder::sendPacket(Packet& pkt) const {
-  return avcodec_send_packet(impl_->decoderContext.get(), pkt);
+int Decoder::threadCount() const {
+  return impl_->decoderContext->thread_count;
+}
+
+void Decoder::setPacketTimeBase(AVRational timeBase) {
+  impl_->decoderContext->pkt_timebase = timeBase;
+}
+
+DecoderStats Decoder::stats() const {
+  DecoderStats stats;
+  stats.decoded = impl_->decoded;
+  stats.skipped = impl_->skipped;
+  return stats;
+}
+
+void Decoder::flush() {
+  avcodec_flush_buffers(impl_->decoderContext.get());
+  impl_->nextDueSet = false;
+}
+
+int Decoder::sendPacket(Packet& pkt) noexcept {
+  AVPacket* packet = pkt;
+  if (!packet->data) {
+    // empty packet puts decoder into draining mode
+    return avcodec_send_packet(impl_->decoderContext.get(), packet);
+  }
+
+  if (impl_->mode == DecodeMode::KeyframesOnly &&
+      !(packet->flags & AV_PKT_FLAG_KEY)) {
+    impl_->skipped++;
+    return EXIT_SUCCESS;
+  }
+  if (impl_->mode == DecodeMode::TargetFps && impl_->timeBaseKnown()) {
+    auto timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    auto due = impl_->due(timestamp);
+    if (!due && (packet->flags & AV_PKT_FLAG_DISPOSABLE)) {
+      impl_->skipped++;
+      return EXIT_SUCCESS;
+    }
+    // reference frames must be decoded anyway, decoder skips the rest
+    impl_->decoderContext->skip_frame =
+        due ? AVDISCARD_DEFAULT : AVDISCARD_NONREF;
+  }
+  return avcodec_send_packet(impl_->decoderContext.get(), packet);
 }
 
-int Decoder::receiveFrame(Frame& frame) {
-  return avcodec_receive_frame(impl_->decoderContext.get(), frame);
+int Decoder::receiveFrame(Frame& frame) noexcept {
+  while (true) {
+    auto err = avcodec_receive_frame(impl_->decoderContext.get(), frame);
+    if (err < EXIT_SUCCESS) {
+      return err;
+    }
+
+    if (impl_->mode == DecodeMode::TargetFps && impl_->timeBaseKnown()) {
+      AVFrame* avFrame = frame;
+      auto timestamp = avFrame->best_effort_timestamp != AV_NOPTS_VALUE
+                           ? avFrame->best_effort_timestamp
+                           : avFrame->pts;
+      if (!impl_->due(timestamp)) {
+        impl_->skipped++;
+        av_frame_unref(avFrame);
+        continue;
+      }
+      impl_->frameDelivered(timestamp);
+    }
+    impl_->decoded++;
+    return EXIT_SUCCESS;
+  }
 }
 
 std::ostream& operator<<(std::ostream& ost, const Decoder& dcdr) {
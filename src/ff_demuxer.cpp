@@ -3,9 +3,18 @@
 #include <ff_cpp/ff_stream.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <fstream>
 #include <functional>
+#include <condition_variable>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "ff_blocking_queue.h"
 
 namespace ff_cpp {
 
@@ -17,40 +26,528 @@ static void avFormatDeleter(AVFormatContext* ctxt) {
 using UniqFormatContext =
     std::unique_ptr<AVFormatContext, decltype(avFormatDeleter)*>;
 
+static void avIOContextDeleter(AVIOContext* ctxt) {
+  if (ctxt) {
+    av_freep(&ctxt->buffer);
+    avio_context_free(&ctxt);
+  }
+};
+using UniqIOContext = std::unique_ptr<AVIOContext, decltype(avIOContextDeleter)*>;
+
 constexpr int COMMON_TIMEOUT = 5;
+constexpr int IO_BUFFER_SIZE = 64 * 1024;
+// probing limits of StartupProbe::Minimal
+constexpr int64_t MINIMAL_PROBE_SIZE = 32;
+constexpr int64_t MINIMAL_ANALYZE_DURATION = AV_TIME_BASE / 10;
+// interrupt states of demuxer, negative ones make interrupt callback return 1
+constexpr int64_t INTERRUPT_NONE = std::numeric_limits<int64_t>::max();
+constexpr int64_t INTERRUPT_TIMED_OUT = -1;
+constexpr int64_t INTERRUPT_STOPPED = -2;
+constexpr std::chrono::milliseconds WATCHDOG_PERIOD{10};
+
+static int ioRead(void* opaque, uint8_t* buf, int size) {
+  return static_cast<IOSource*>(opaque)->read(buf, size);
+}
+
+static int64_t ioSeek(void* opaque, int64_t offset, int whence) {
+  return static_cast<IOSource*>(opaque)->seek(offset, whence);
+}
+
+constexpr char KEYFRAME_INDEX_HEADER[] = "ff_cpp keyframe index 2";
+
+void KeyframeIndex::save(const std::string& path) const {
+  std::ofstream file{path, std::ofstream::trunc};
+  file << KEYFRAME_INDEX_HEADER << "\n";
+  file << streamIndex << " " << timeBase.num << " " << timeBase.den << " "
+       << timestamps.size() << "\n";
+  file << inputSize << " " << duration << "\n";
+  for (size_t i = 0; i < timestamps.size(); i++) {
+    file << timestamps[i] << " " << (i < positions.size() ? positions[i] : -1)
+         << "\n";
+  }
+  if (!file) {
+    throw FFCppException("Unable to write keyframe index to " + path);
+  }
+}
+
+KeyframeIndex KeyframeIndex::load(const std::string& path) {
+  std::ifstream file{path};
+  std::string header;
+  if (!std::getline(file, header)) {
+    throw BadInput("Unable to read keyframe index", path);
+  }
+  if (header != KEYFRAME_INDEX_HEADER) {
+    throw BadInput("Not a keyframe index", path);
+  }
+
+  KeyframeIndex index;
+  size_t size{};
+  file >> index.streamIndex >> index.timeBase.num >> index.timeBase.den >>
+      size;
+  file >> index.inputSize >> index.duration;
+  for (size_t i = 0; file && i < size; i++) {
+    int64_t timestamp{};
+    int64_t position{};
+    file >> timestamp >> position;
+    index.timestamps.push_back(timestamp);
+    index.positions.push_back(position);
+  }
+  if (!file || index.streamIndex < 0 ||
+      !std::is_sorted(index.timestamps.begin(), index.timestamps.end())) {
+    throw BadInput("Malformed keyframe index", path);
+  }
+  return index;
+}
+
+/**
+ * @brief Coarse clock and checker of request deadlines of all demuxers.
+ * Deadlines are checked here once per period instead of in interrupt
+ * callback, so the callback, which is polled by ffmpeg very often, is a
+ * single relaxed load
+ */
+class Watchdog {
+ public:
+  static Watchdog& instance() {
+    // never destroyed, demuxers could be destroyed after static objects
+    static Watchdog* watchdog = new Watchdog;
+    return *watchdog;
+  }
+
+  /**
+   * @brief Milliseconds since watchdog start with precision of its period
+   */
+  int64_t now() const { return now_.load(std::memory_order_relaxed); }
+
+  void add(std::atomic<int64_t>* state) {
+    std::lock_guard<std::mutex> lg{mutex_};
+    states_.push_back(state);
+  }
+
+  void remove(std::atomic<int64_t>* state) {
+    std::lock_guard<std::mutex> lg{mutex_};
+    states_.erase(std::remove(states_.begin(), states_.end(), state),
+                  states_.end());
+  }
+
+ private:
+  Watchdog() : start_(std::chrono::steady_clock::now()) {
+    std::thread{[this]() { run(); }}.detach();
+  }
+
+  void run() {
+    while (true) {
+      std::this_thread::sleep_for(WATCHDOG_PERIOD);
+      auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - start_)
+                     .count();
+      now_.store(now, std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lg{mutex_};
+      for (auto state : states_) {
+        auto deadline = state->load(std::memory_order_relaxed);
+        if (deadline >= 0 && deadline <= now) {
+          // fails if new request started or demuxer stopped meanwhile
+          state->compare_exchange_strong(deadline, INTERRUPT_TIMED_OUT,
+                                         std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<std::atomic<int64_t>*> states_;
+  const std::chrono::steady_clock::time_point start_;
+  std::atomic<int64_t> now_{};
+};
+
+/**
+ * @brief Consumer of frames with its own thread and queue, see
+ * Demuxer::subscribe()
+ */
+struct Subscriber {
+  Subscriber(size_t subscriberId, frame_callback callback,
+             const SubscriberOptions& subscriberOptions)
+      : id(subscriberId),
+        fc(std::move(callback)),
+        options(subscriberOptions),
+        frames{options.queueSize, options.policy, &dropped} {
+    thread = std::thread{[this]() { run(); }};
+  }
+
+  ~Subscriber() {
+    frames.abort();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+
+  void run() {
+    while (auto frame = frames.pop()) {
+      try {
+        fc(*frame);
+        delivered++;
+      } catch (...) {
+        std::lock_guard<std::mutex> lg{errorMutex};
+        error = std::current_exception();
+        frames.abort();
+      }
+    }
+  }
+
+  const size_t id;
+  frame_callback fc;
+  const SubscriberOptions options;
+  std::atomic<uint64_t> delivered{};
+  std::atomic<uint64_t> dropped{};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+  BlockingQueue<Frame> frames;
+  std::thread thread;
+};
+using Subscribers = std::vector<std::shared_ptr<Subscriber>>;
 
 struct Demuxer::Impl {
   std::string input;
   std::string inputFormat;
+  std::shared_ptr<IOSource> ioSource;
+  // custom io context must outlive format context
+  UniqIOContext ioContext{nullptr, avIOContextDeleter};
+  bool nonBlocking{};
   UniqFormatContext demuxerContext{nullptr, avFormatDeleter};
   std::vector<Stream> streams;
   std::map<size_t, Decoder> decoders;
+  std::map<int, KeyframeIndex> keyframeIndexes;
+  std::shared_ptr<StreamInfoCache> streamInfoCache;
+  StartupProbe startupProbe{StartupProbe::Skip};
+  PrepareStats prepareStats;
+  // reported by prepare() which wraps tryPrepare()
+  ParametersContainer notAcceptedOptions;
+  std::exception_ptr prepareError;
+  // indexed by stream index, so dispatch of packet is one array load
+  std::vector<StreamRoute> routes;
+  int bestVideoStream{AVERROR_STREAM_NOT_FOUND};
+  std::unique_ptr<PacketPool> packetPool;
+
+  // state of pull routine
+  Packet pullPacket;
+  const StreamRoute* pendingRoute{};
+  std::vector<const StreamRoute*> flushQueue;
+  bool endOfFile{};
 
-  bool doWork{};
+  std::atomic<bool> doWork{};
+  std::atomic<uint64_t> packetsDropped{};
+  std::atomic<uint64_t> framesDropped{};
 
-  volatile bool timeoutElapsed{};
+  // deadline of current ffmpeg request in Watchdog::now() units or one of
+  // INTERRUPT_* states, it is what interrupt callback checks
+  std::atomic<int64_t> interrupt{INTERRUPT_NONE};
+  // number of stop() calls, prepare keeps stop() called after it was
+  // requested
+  std::atomic<uint64_t> stops{};
   std::chrono::seconds timeout{};
-  std::chrono::steady_clock::time_point timePoint{};
+
+  // copied on change, so frames are published without lock, declared last
+  // to join subscriber threads before rest of demuxer is destroyed
+  std::mutex subscribersMutex;
+  std::shared_ptr<const Subscribers> subscribers;
+  size_t nextSubscriberId{};
+
+  Impl() { Watchdog::instance().add(&interrupt); }
+  ~Impl() { Watchdog::instance().remove(&interrupt); }
+
+  /**
+   * @brief set deadline of new ffmpeg request, stop() is kept until
+   * restart()
+   */
+  void updateRequestTime() {
+    auto deadline = Watchdog::instance().now() +
+                    std::chrono::milliseconds{timeout}.count();
+    auto state = interrupt.load(std::memory_order_relaxed);
+    while (state != INTERRUPT_STOPPED &&
+           !interrupt.compare_exchange_weak(state, deadline,
+                                            std::memory_order_relaxed)) {
+    }
+  }
 
   /**
-   * @brief set start time point of new ffmpeg request
+   * @brief reset stop() before new routine
    */
-  void updateRequestTime() { timePoint = std::chrono::steady_clock::now(); }
+  void restart() {
+    interrupt.store(INTERRUPT_NONE, std::memory_order_relaxed);
+    doWork = true;
+  }
 
-  static int interrupt_callback(void* opaque) {
-    auto demuxer = static_cast<Demuxer*>(opaque);
-    if (demuxer) {
-      auto now = std::chrono::steady_clock::now();
-      auto timeElapsed = std::chrono::duration_cast<std::chrono::seconds>(
-          now - demuxer->impl_->timePoint);
-      if (demuxer->impl_->timeout <= timeElapsed) {
-        demuxer->impl_->timeoutElapsed = true;
-        return 1;
-      } else {
-        return 0;
+  bool timedOut() const {
+    return interrupt.load(std::memory_order_relaxed) == INTERRUPT_TIMED_OUT;
+  }
+
+  bool stopped() const {
+    return interrupt.load(std::memory_order_relaxed) == INTERRUPT_STOPPED;
+  }
+
+  /**
+   * @brief Return packet pool with at least required capacity
+   * @note packets taken from previous pool keep it alive until destroyed
+   */
+  PacketPool& packetPoolFor(size_t capacity) {
+    if (!packetPool || packetPool->capacity() < capacity) {
+      packetPool = std::make_unique<PacketPool>(capacity);
+    }
+    return *packetPool;
+  }
+
+  /**
+   * @brief State shared between threads of pipelined routine
+   */
+  struct Pipeline {
+    Pipeline(const PipelineOptions& options,
+             std::atomic<uint64_t>& framesDropped)
+        : frames{options.frameQueueSize, options.framePolicy, &framesDropped} {
+    }
+
+    struct DecodedFrame {
+      Frame frame;
+      const StreamRoute* route{};
+    };
+
+    // indexed by stream index, nullptr for streams without decoder
+    std::vector<std::unique_ptr<BlockingQueue<Packet>>> packets;
+    BlockingQueue<DecodedFrame> frames;
+    // demux thread and every decode thread produce frames queue
+    std::atomic<size_t> producers{1};
+    std::atomic<bool> endOfFile{};
+    std::atomic<bool> aborted{};
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+    void setError(std::exception_ptr err) {
+      std::lock_guard<std::mutex> lg{errorMutex};
+      if (!error) {
+        error = err;
+      }
+    }
+
+    void closePackets() {
+      for (auto& queue : packets) {
+        if (queue) {
+          queue->close();
+        }
+      }
+    }
+
+    void abort() {
+      aborted = true;
+      for (auto& queue : packets) {
+        if (queue) {
+          queue->abort();
+        }
+      }
+      frames.abort();
+    }
+
+    void producerDone() {
+      if (--producers == 0) {
+        frames.close();
+      }
+    }
+  };
+
+  /**
+   * @brief Throw if demuxer not prepared or stream index out of range
+   */
+  /**
+   * @brief Size of input in bytes, -1 if unknown
+   */
+  int64_t inputSize() const {
+    const auto size = demuxerContext->pb ? avio_size(demuxerContext->pb) : -1;
+    return size >= 0 ? size : -1;
+  }
+
+  StreamRoute& route(size_t streamIndex) {
+    if (!demuxerContext) {
+      throw FFCppException("Demuxer not prepared");
+    }
+    if (streamIndex >= routes.size()) {
+      throw NoStream("There is no stream with such index");
+    }
+    return routes[streamIndex];
+  }
+
+  /**
+   * @brief Open and probe input requested when stop() was called
+   * stopsAtRequest times, expected failures are returned, unexpected ones are
+   * thrown
+   */
+  Status prepare(const ParametersContainer& params, unsigned int timeoutSec,
+                 uint64_t stopsAtRequest) {
+    // stop() called before the request is dropped, the one called after it
+    // is kept, stop() stores its state after it counts itself
+    interrupt.store(INTERRUPT_NONE);
+    if (stops.load() != stopsAtRequest) {
+      interrupt.store(INTERRUPT_STOPPED);
+    }
+    if (stopped()) {
+      return Status{StatusCode::Interrupted, 0,
+                    "Demuxer stopped before prepare"};
+    }
+
+    AVFormatContext* fmtCntxt = avformat_alloc_context();
+    if (!fmtCntxt) {
+      return Status{StatusCode::Error, AVERROR(ENOMEM)};
+    }
+    fmtCntxt->interrupt_callback.callback = interrupt_callback;
+    fmtCntxt->interrupt_callback.opaque = &interrupt;
+
+    // io context of previous prepare is replaced only after new input is
+    // opened, previous format context still reads through it
+    UniqIOContext newIOContext{nullptr, avIOContextDeleter};
+    if (ioSource) {
+      auto buffer = static_cast<unsigned char*>(av_malloc(IO_BUFFER_SIZE));
+      newIOContext.reset(avio_alloc_context(buffer, IO_BUFFER_SIZE, 0,
+                                            ioSource.get(), ioRead, nullptr,
+                                            ioSeek));
+      if (!buffer || !newIOContext) {
+        if (!newIOContext) {
+          av_free(buffer);
+        }
+        avformat_free_context(fmtCntxt);
+        return Status{StatusCode::Error, AVERROR(ENOMEM)};
+      }
+      fmtCntxt->pb = newIOContext.get();
+      fmtCntxt->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
+    AVDictionary* optionsDict{};
+    for (const auto& param : params) {
+      av_dict_set(&optionsDict, param.first.c_str(), param.second.c_str(), 0);
+    }
+    std::unique_ptr<AVDictionary*, decltype(&av_dict_free)> optionsGuard{
+        &optionsDict, av_dict_free};
+
+    AVInputFormat* iFormat = av_find_input_format(inputFormat.c_str());
+
+    timeout = std::chrono::seconds{timeoutSec};
+    updateRequestTime();
+    prepareStats = PrepareStats{};
+    notAcceptedOptions.clear();
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [](std::chrono::steady_clock::time_point from) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - from);
+    };
+
+    // source is shared with previous io context, its position is restored if
+    // new input is not opened, so previous input is read further as before
+    const auto sourcePosition = ioSource ? ioSource->seek(0, SEEK_CUR) : -1;
+    if (ioSource) {
+      ioSource->seek(0, SEEK_SET);
+    }
+    auto err =
+        avformat_open_input(&fmtCntxt, input.c_str(), iFormat, &optionsDict);
+    if (err < EXIT_SUCCESS) {
+      if (sourcePosition >= 0) {
+        ioSource->seek(sourcePosition, SEEK_SET);
+      }
+      if (timedOut()) {
+        return Status{StatusCode::TimeoutElapsed, 0,
+                      "Timeout elapsed while open input"};
+      }
+      if (stopped()) {
+        return Status{StatusCode::Interrupted, 0,
+                      "Demuxer stopped while open input"};
+      }
+      return Status{StatusCode::BadInput, err};
+    }
+    // everything bound to streams of previous input goes away with it,
+    // format context is closed before io context it reads through
+    av_packet_unref(pullPacket);
+    pendingRoute = nullptr;
+    flushQueue.clear();
+    endOfFile = false;
+    routes.clear();
+    decoders.clear();
+    keyframeIndexes.clear();
+    streams.clear();
+    bestVideoStream = AVERROR_STREAM_NOT_FOUND;
+    demuxerContext.reset(fmtCntxt);
+    ioContext = std::move(newIOContext);
+    prepareStats.openInput = elapsed(start);
+
+    const auto& cache = streamInfoCache;
+    auto& cached = prepareStats.streamInfoCached;
+    const auto probeStart = std::chrono::steady_clock::now();
+    const auto probeSize = fmtCntxt->probesize;
+    const auto analyzeDuration = fmtCntxt->max_analyze_duration;
+    auto minimalProbe = false;
+    if (cache && startupProbe == StartupProbe::Skip) {
+      cached = cache->apply(input, fmtCntxt);
+    } else if (cache && cache->contains(input)) {
+      // probe just enough to find out stream layout, the rest is cached
+      fmtCntxt->probesize = MINIMAL_PROBE_SIZE;
+      fmtCntxt->max_analyze_duration = MINIMAL_ANALYZE_DURATION;
+      minimalProbe = true;
+    }
+    auto findStreamInfo = [this, fmtCntxt]() {
+      if (auto err = avformat_find_stream_info(fmtCntxt, nullptr);
+          err < EXIT_SUCCESS) {
+        if (timedOut()) {
+          return Status{StatusCode::TimeoutElapsed, 0,
+                        "Timeout elapsed while find stream info"};
+        }
+        if (stopped()) {
+          return Status{StatusCode::Interrupted, 0,
+                        "Demuxer stopped while find stream info"};
+        }
+        return Status{StatusCode::NoStream, err};
+      }
+      return Status{};
+    };
+    if (!cached) {
+      if (auto status = findStreamInfo(); !status.ok()) {
+        return status;
+      }
+      if (minimalProbe) {
+        cached = cache->apply(input, fmtCntxt);
+        if (!cached) {
+          // input changed since it was cached, parameters found by minimal
+          // probing are incomplete, so input is probed in full before store
+          fmtCntxt->probesize = probeSize;
+          fmtCntxt->max_analyze_duration = analyzeDuration;
+          if (auto status = findStreamInfo(); !status.ok()) {
+            return status;
+          }
+        }
+      }
+      if (cache && !cached) {
+        cache->store(input, fmtCntxt);
+      }
+      prepareStats.findStreamInfo = elapsed(probeStart);
+    }
+
+    for (unsigned int i = 0; i < demuxerContext->nb_streams; i++) {
+      streams.emplace_back(Stream{demuxerContext->streams[i]});
+    }
+    routes.assign(streams.size(), StreamRoute{});
+    bestVideoStream = av_find_best_stream(
+        demuxerContext.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    timeout = std::chrono::seconds{COMMON_TIMEOUT};
+    prepareStats.total = elapsed(start);
+
+    if (optionsDict != nullptr) {
+      AVDictionaryEntry* opt = nullptr;
+      while ((opt = av_dict_get(optionsDict, "", opt, AV_DICT_IGNORE_SUFFIX))) {
+        notAcceptedOptions[opt->key] = opt->value;
       }
+      return Status{StatusCode::OptionsNotAccepted, 0,
+                    "Not all options accepted"};
     }
-    return 1;
+    return Status{};
+  }
+
+  static int interrupt_callback(void* opaque) {
+    return static_cast<std::atomic<int64_t>*>(opaque)->load(
+               std::memory_order_relaxed) < 0;
   }
 };
 
@@ -61,58 +558,130 @@ Demuxer::Demuxer(const std::string& inputSource,
   impl_->inputFormat = inputFormat;
 }
 
+Demuxer::Demuxer(std::shared_ptr<IOSource> source,
+                 const std::string& inputFormat) {
+  if (!source) {
+    throw BadInput("Input source is null", "");
+  }
+  impl_ = std::make_unique<Impl>();
+  impl_->input = source->name();
+  impl_->inputFormat = inputFormat;
+  impl_->ioSource = std::move(source);
+}
+
+Demuxer::Demuxer(const uint8_t* data, size_t size,
+                 const std::string& inputFormat)
+    : Demuxer(std::make_shared<MemorySource>(data, size), inputFormat) {}
+
 Demuxer::~Demuxer() {}
 
 const std::string& Demuxer::inputSource() const { return impl_->input; }
 
 void Demuxer::prepare(const ParametersContainer& params, unsigned int timeout) {
-  AVFormatContext* fmtCntxt = avformat_alloc_context();
-  fmtCntxt->interrupt_callback.callback = Impl::interrupt_callback;
-  fmtCntxt->interrupt_callback.opaque = this;
+  prepare(params, timeout, impl_->stops);
+}
 
-  AVDictionary* optionsDict{};
-  for (const auto& param : params) {
-    av_dict_set(&optionsDict, param.first.c_str(), param.second.c_str(), 0);
+void Demuxer::prepare(const ParametersContainer& params, unsigned int timeout,
+                      uint64_t stops) {
+  auto status = tryPrepare(params, timeout, stops);
+  if (impl_->prepareError) {
+    std::rethrow_exception(impl_->prepareError);
+  }
+  switch (status.code()) {
+    case StatusCode::BadInput:
+      throw BadInput(status.message(), impl_->input);
+    case StatusCode::OptionsNotAccepted:
+      throw OptionsNotAccepted(status.message(), impl_->notAcceptedOptions);
+    default:
+      status.throwIfError();
   }
+}
 
-  AVInputFormat* iFormat = av_find_input_format(impl_->inputFormat.c_str());
+Status Demuxer::tryPrepare(const ParametersContainer& params,
+                           unsigned int timeout) noexcept {
+  return tryPrepare(params, timeout, impl_->stops);
+}
 
-  impl_->timeout = std::chrono::seconds{timeout};
-  impl_->updateRequestTime();
+Status Demuxer::tryPrepare(const ParametersContainer& params,
+                           unsigned int timeout, uint64_t stops) noexcept {
+  impl_->prepareError = nullptr;
+  try {
+    return impl_->prepare(params, timeout, stops);
+  } catch (...) {
+    // unexpected failure, like out of memory, prepare() rethrows it as is
+    impl_->prepareError = std::current_exception();
+    return Status{StatusCode::Error, 0, "Unable to prepare input"};
+  }
+}
 
-  if (auto err = avformat_open_input(&fmtCntxt, impl_->input.c_str(), iFormat,
-                                     &optionsDict);
-      err == EXIT_SUCCESS) {
-    impl_->demuxerContext.reset(fmtCntxt);
+std::future<void> Demuxer::prepareAsync(const ParametersContainer& params,
+                                        unsigned int timeout) {
+  return std::async(std::launch::async,
+                    [this, params, timeout, stops = impl_->stops.load()]() {
+                      prepare(params, timeout, stops);
+                    });
+}
 
-    if (err = avformat_find_stream_info(impl_->demuxerContext.get(), nullptr);
-        err < EXIT_SUCCESS) {
-      if (impl_->timeoutElapsed) {
-        throw TimeoutElapsed("Timeout elapsed while find stream info");
-      }
-      throw NoStream(av_err2str(err));
-    }
+std::vector<PrepareResult> prepareAll(const std::vector<Demuxer*>& demuxers,
+                                      size_t concurrency,
+                                      const ParametersContainer& params,
+                                      unsigned int timeout) {
+  std::vector<PrepareResult> results(demuxers.size());
+  if (demuxers.empty()) {
+    return results;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  auto elapsed = [](std::chrono::steady_clock::time_point from) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - from);
+  };
 
-    for (unsigned int i = 0; i < impl_->demuxerContext->nb_streams; i++) {
-      impl_->streams.emplace_back(Stream{impl_->demuxerContext->streams[i]});
-    }
+  // stop() called while demuxer waits in queue cancels its prepare()
+  std::vector<uint64_t> stops(demuxers.size());
+  for (size_t i = 0; i < demuxers.size(); i++) {
+    stops[i] = demuxers[i] ? demuxers[i]->impl_->stops.load() : 0;
+  }
 
-    if (optionsDict != nullptr) {
-      AVDictionaryEntry* opt = nullptr;
-      ParametersContainer params;
-      while ((opt = av_dict_get(optionsDict, "", opt, AV_DICT_IGNORE_SUFFIX))) {
-        params[opt->key] = opt->value;
+  std::atomic<size_t> next{};
+  auto worker = [&]() {
+    for (auto i = next++; i < demuxers.size(); i = next++) {
+      auto& result = results[i];
+      result.demuxer = demuxers[i];
+      result.queued = elapsed(start);
+      const auto prepareStart = std::chrono::steady_clock::now();
+      try {
+        if (!result.demuxer) {
+          throw FFCppException("Demuxer is null");
+        }
+        result.demuxer->prepare(params, timeout, stops[i]);
+        result.stats = result.demuxer->prepareStats();
+      } catch (...) {
+        result.error = std::current_exception();
       }
-      throw OptionsNotAccepted("Not all options accepted", params);
-    }
-  } else {
-    if (impl_->timeoutElapsed) {
-      throw TimeoutElapsed("Timeout elapsed while open input");
+      result.elapsed = elapsed(prepareStart);
     }
-    throw BadInput(av_err2str(err), impl_->input);
+  };
+
+  const auto threads = concurrency ? std::min(concurrency, demuxers.size())
+                                   : demuxers.size();
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(worker);
+  }
+  for (auto& thread : workers) {
+    thread.join();
   }
+  return results;
 }
 
+void Demuxer::setStreamInfoCache(std::shared_ptr<StreamInfoCache> cache,
+                                 StartupProbe probe) {
+  impl_->streamInfoCache = std::move(cache);
+  impl_->startupProbe = probe;
+}
+
+PrepareStats Demuxer::prepareStats() const { return impl_->prepareStats; }
+
 MetadataContainer Demuxer::metadata() const {
   if (!impl_->demuxerContext) {
     return {};
@@ -139,16 +708,35 @@ Stream& Demuxer::bestVideoStream() const {
   if (!impl_->demuxerContext) {
     throw FFCppException("Demuxer not prepared");
   }
-  auto streamIndex = av_find_best_stream(
-      impl_->demuxerContext.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
-  if (streamIndex < EXIT_SUCCESS) {
-    throw NoStream(av_err2str(streamIndex));
+  if (impl_->bestVideoStream < EXIT_SUCCESS) {
+    throw NoStream(av_err2str(impl_->bestVideoStream));
+  }
+
+  return impl_->streams[impl_->bestVideoStream];
+}
+
+void Demuxer::selectStreams(const std::vector<size_t>& streamIndexes) {
+  if (!impl_->demuxerContext) {
+    throw FFCppException("Demuxer not prepared");
+  }
+  for (auto index : streamIndexes) {
+    if (index >= impl_->demuxerContext->nb_streams) {
+      throw NoStream("There is no stream with such index");
+    }
   }
 
-  return impl_->streams[streamIndex];
+  for (unsigned int i = 0; i < impl_->demuxerContext->nb_streams; i++) {
+    auto selected =
+        streamIndexes.empty() ||
+        std::find(streamIndexes.begin(), streamIndexes.end(), i) !=
+            streamIndexes.end();
+    impl_->demuxerContext->streams[i]->discard =
+        selected ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+  }
 }
 
-Decoder& Demuxer::createDecoder(size_t streamIndex, AVCodecID requiredCodec) {
+Decoder& Demuxer::createDecoder(size_t streamIndex, AVCodecID requiredCodec,
+                               const DecoderOptions& options) {
   if (streamIndex >= impl_->streams.size()) {
     throw NoStream("There is no stream with such index");
   }
@@ -157,10 +745,222 @@ Decoder& Demuxer::createDecoder(size_t streamIndex, AVCodecID requiredCodec) {
 
   AVCodecID codec =
       requiredCodec == AV_CODEC_ID_NONE ? stream.codec() : requiredCodec;
+  // decoder created for the stream before is replaced
+  impl_->routes[stream.index()].decoder = nullptr;
+  impl_->decoders.erase(stream.index());
   impl_->decoders.emplace(
       stream.index(),
-      Decoder{codec, impl_->demuxerContext->streams[stream.index()]->codecpar});
-  return impl_->decoders.at(stream.index());
+      Decoder{codec, impl_->demuxerContext->streams[stream.index()]->codecpar,
+              {}, options});
+  auto& decoder = impl_->decoders.at(stream.index());
+  decoder.setPacketTimeBase(
+      impl_->demuxerContext->streams[stream.index()]->time_base);
+  impl_->routes[stream.index()].decoder = &decoder;
+  return decoder;
+}
+
+void Demuxer::seek(int64_t timestamp, int flags, int streamIndex) {
+  if (!impl_->demuxerContext) {
+    throw FFCppException("Demuxer not prepared");
+  }
+  impl_->updateRequestTime();
+  if (auto err = av_seek_frame(impl_->demuxerContext.get(), streamIndex,
+                               timestamp, flags);
+      err < EXIT_SUCCESS) {
+    if (impl_->timedOut()) {
+      throw TimeoutElapsed("Timeout elapsed while seek");
+    }
+    if (impl_->stopped()) {
+      throw Interrupted("Demuxer stopped while seek");
+    }
+    throw ProcessingError(av_err2str(err));
+  }
+
+  for (auto& decoder : impl_->decoders) {
+    decoder.second.flush();
+  }
+  av_packet_unref(impl_->pullPacket);
+  impl_->pendingRoute = nullptr;
+  impl_->flushQueue.clear();
+  impl_->endOfFile = false;
+}
+
+KeyframeIndex Demuxer::keyframeIndex(size_t streamIndex) {
+  impl_->route(streamIndex);
+  auto stream = impl_->demuxerContext->streams[streamIndex];
+  KeyframeIndex index;
+  index.streamIndex = static_cast<int>(streamIndex);
+  index.timeBase = stream->time_base;
+  index.inputSize = impl_->inputSize();
+  index.duration = stream->duration;
+
+  for (int i = 0; i < stream->nb_index_entries; i++) {
+    if (stream->index_entries[i].flags & AVINDEX_KEYFRAME) {
+      index.timestamps.push_back(stream->index_entries[i].timestamp);
+      index.positions.push_back(stream->index_entries[i].pos);
+    }
+  }
+  if (!index.timestamps.empty()) {
+    return index;
+  }
+
+  // container has no index, so packets are scanned
+  std::map<int64_t, int64_t> positions;
+  Packet packet;
+  while (true) {
+    auto err = readPacket(packet);
+    if (err == AVERROR_EOF) {
+      break;
+    } else if (err < EXIT_SUCCESS) {
+      throwError(err);
+    }
+    AVPacket* pkt = packet;
+    auto timestamp = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (pkt->stream_index == index.streamIndex &&
+        (pkt->flags & AV_PKT_FLAG_KEY) && timestamp != AV_NOPTS_VALUE) {
+      positions.emplace(timestamp, pkt->pos);
+    }
+  }
+  for (const auto& position : positions) {
+    index.timestamps.push_back(position.first);
+    index.positions.push_back(position.second);
+  }
+
+  if (!index.timestamps.empty()) {
+    seek(index.timestamps.front(), AVSEEK_FLAG_BACKWARD, index.streamIndex);
+  } else {
+    auto startTime = impl_->demuxerContext->start_time;
+    seek(startTime != AV_NOPTS_VALUE ? startTime : 0, AVSEEK_FLAG_BACKWARD);
+  }
+  return index;
+}
+
+void Demuxer::setKeyframeIndex(const KeyframeIndex& index) {
+  if (index.streamIndex < 0 ||
+      static_cast<size_t>(index.streamIndex) >= impl_->streams.size()) {
+    throw NoStream("There is no stream with such index");
+  }
+  // timestamps of index of other input point to wrong packets, so index is
+  // rejected unless identity of input known on both sides is the same
+  auto stream = impl_->demuxerContext->streams[index.streamIndex];
+  const auto inputSize = impl_->inputSize();
+  if (av_cmp_q(index.timeBase, stream->time_base) != 0 ||
+      (index.inputSize >= 0 && inputSize >= 0 &&
+       index.inputSize != inputSize) ||
+      (index.duration != AV_NOPTS_VALUE && stream->duration != AV_NOPTS_VALUE &&
+       index.duration != stream->duration)) {
+    throw BadInput("Keyframe index is built for other input", impl_->input);
+  }
+  impl_->keyframeIndexes[index.streamIndex] = index;
+}
+
+Frame Demuxer::frameAt(size_t streamIndex, int64_t pts) {
+  auto& route = impl_->route(streamIndex);
+  if (!route.decoder) {
+    throw FFCppException("There is no decoder for the stream");
+  }
+  const auto stream = static_cast<int>(streamIndex);
+  const auto startTime = impl_->demuxerContext->streams[stream]->start_time;
+  const auto index = impl_->keyframeIndexes.find(stream);
+  const auto indexed = index != impl_->keyframeIndexes.end() &&
+                       !index->second.timestamps.empty();
+  const auto byteSeek =
+      !(impl_->demuxerContext->iformat->flags & AVFMT_NO_BYTE_SEEK);
+
+  auto seekTarget = pts;
+  auto previousKeyframe = AV_NOPTS_VALUE;
+  while (true) {
+    if (indexed) {
+      const auto& timestamps = index->second.timestamps;
+      const auto& positions = index->second.positions;
+      auto keyframe =
+          std::upper_bound(timestamps.begin(), timestamps.end(), seekTarget);
+      if (keyframe != timestamps.begin()) {
+        keyframe--;
+      }
+      auto i = static_cast<size_t>(keyframe - timestamps.begin());
+      if (byteSeek && i < positions.size() && positions[i] >= 0) {
+        seek(positions[i], AVSEEK_FLAG_BYTE);
+      } else {
+        seek(*keyframe, AVSEEK_FLAG_BACKWARD, stream);
+      }
+    } else {
+      seek(seekTarget, AVSEEK_FLAG_BACKWARD, stream);
+    }
+
+    // decoding timestamp of keyframe decoding started from
+    auto keyframe = AV_NOPTS_VALUE;
+    Frame result;
+    auto decoded = false;
+    auto late = false;
+    auto done = false;
+    auto drained = false;
+    Packet packet;
+    while (!done) {
+      auto err = readPacket(packet);
+      if (err == AVERROR_EOF) {
+        // empty packet puts decoder into draining mode
+        av_packet_unref(packet);
+        done = true;
+        drained = true;
+      } else if (err < EXIT_SUCCESS) {
+        throwError(err);
+      } else if (packet.streamIndex() != stream) {
+        continue;
+      } else if (keyframe == AV_NOPTS_VALUE) {
+        keyframe = packet.dts() != AV_NOPTS_VALUE ? packet.dts() : packet.pts();
+      }
+      if (err = route.decoder->sendPacket(packet); err < EXIT_SUCCESS) {
+        throwError(err);
+      }
+
+      while (true) {
+        Frame frame;
+        err = route.decoder->receiveFrame(frame);
+        if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+          break;
+        } else if (err < EXIT_SUCCESS) {
+          throwError(err);
+        }
+        if (frame.pts() != AV_NOPTS_VALUE && frame.pts() > pts) {
+          late = !decoded;
+          if (!decoded) {
+            result = std::move(frame);
+            decoded = true;
+          }
+          done = true;
+          break;
+        }
+        result = std::move(frame);
+        decoded = true;
+      }
+    }
+    if (drained) {
+      // decoder must be flushed before next use
+      route.decoder->flush();
+    }
+
+    // keyframe decoded before pts could be displayed after it, in that case
+    // decoding starts again from previous keyframe
+    if (late && keyframe != AV_NOPTS_VALUE && keyframe != previousKeyframe &&
+        (startTime == AV_NOPTS_VALUE || keyframe > startTime)) {
+      previousKeyframe = keyframe;
+      seekTarget = keyframe - 1;
+      continue;
+    }
+    if (!decoded) {
+      throw EndOfFile("There is no frame in the stream");
+    }
+    return result;
+  }
+}
+
+void Demuxer::onPacket(size_t streamIndex, packet_callback pc) {
+  impl_->route(streamIndex).onPacket = std::move(pc);
+}
+
+void Demuxer::onFrame(size_t streamIndex, frame_callback fc) {
+  impl_->route(streamIndex).onFrame = std::move(fc);
 }
 
 const std::map<size_t, Decoder>& Demuxer::decoders() const {
@@ -168,54 +968,360 @@ const std::map<size_t, Decoder>& Demuxer::decoders() const {
 }
 
 void Demuxer::start(frame_callback fc, packet_callback pc) {
+  start<frame_callback&, packet_callback&>(fc, pc);
+}
+
+void Demuxer::start(frame_callback fc, packet_callback pc,
+                    const PipelineOptions& options) {
   if (!impl_->demuxerContext) {
     throw FFCppException("Demuxer not prepared");
   }
 
-  Frame frame;
-  int err = EXIT_SUCCESS;
-  impl_->doWork = true;
   impl_->timeout = std::chrono::seconds{COMMON_TIMEOUT};
+  impl_->restart();
 
-  while (impl_->doWork) {
-    Packet packet;
-    impl_->updateRequestTime();
-    if ((err = av_read_frame(impl_->demuxerContext.get(), packet)) <
-        EXIT_SUCCESS) {
-      if (impl_->timeoutElapsed) {
-        throw TimeoutElapsed("Timeout elapsed while read frame");
-      }
-      if (err == AVERROR_EOF) {
-        throw EndOfFile("End of file reached");
-      }
-      throw ProcessingError(std::string{"av_read_frame error: "} +
-                            av_err2str(err));
-    }
-
-    if (pc(packet) &&
-        (impl_->decoders.find(packet.streamIndex()) != impl_->decoders.end())) {
-      auto& decoder = impl_->decoders.at(packet.streamIndex());
-      impl_->updateRequestTime();
-      if (err = decoder.sendPacket(packet); err >= EXIT_SUCCESS) {
-        err = EXIT_SUCCESS;
-        while (err >= EXIT_SUCCESS) {
-          err = decoder.receiveFrame(frame);
+  impl_->packetsDropped = 0;
+  impl_->framesDropped = 0;
+  Impl::Pipeline pipeline{options, impl_->framesDropped};
+  pipeline.packets.resize(impl_->routes.size());
+  size_t decodeRoutes = 0;
+  for (size_t i = 0; i < impl_->routes.size(); i++) {
+    if (impl_->routes[i].decoder) {
+      pipeline.packets[i] = std::make_unique<BlockingQueue<Packet>>(
+          options.packetQueueSize, options.packetPolicy,
+          &impl_->packetsDropped);
+      decodeRoutes++;
+    }
+  }
+  // one producer per decode thread started below
+  pipeline.producers += decodeRoutes;
+  // each decoder holds one packet in addition to its queue, one more packet
+  // is held by demux thread
+  auto& packetPool = impl_->packetPoolFor(
+      decodeRoutes * (options.packetQueueSize + 1) + 1);
+
+  std::vector<std::thread> decodeThreads;
+  for (size_t i = 0; i < impl_->routes.size(); i++) {
+    if (!pipeline.packets[i]) {
+      continue;
+    }
+    auto& route = impl_->routes[i];
+    auto& packets = *pipeline.packets[i];
+    decodeThreads.emplace_back([&pipeline, &route, &packets]() {
+      auto& decoder = *route.decoder;
+      auto decode = [&pipeline, &route, &decoder](Packet& packet) {
+        if (auto err = decoder.sendPacket(packet); err < EXIT_SUCCESS) {
+          throw ProcessingError(av_err2str(err));
+        }
+        while (true) {
+          Frame frame;
+          auto err = decoder.receiveFrame(frame);
           if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
-            break;
-          } else if (err == AVERROR(EINVAL) || err < 0) {
+            return;
+          } else if (err < EXIT_SUCCESS) {
             throw ProcessingError(av_err2str(err));
           }
+          if (!pipeline.frames.push({std::move(frame), &route})) {
+            return;
+          }
+        }
+      };
+
+      try {
+        while (auto packet = packets.pop()) {
+          decode(*packet);
+        }
+        if (pipeline.endOfFile && !pipeline.aborted) {
+          // empty packet puts decoder into draining mode
+          Packet flushPacket;
+          decode(flushPacket);
+        }
+      } catch (...) {
+        pipeline.setError(std::current_exception());
+        pipeline.abort();
+      }
+      pipeline.producerDone();
+    });
+  }
+
+  std::thread demuxThread{[this, &pipeline, &pc, &packetPool]() {
+    try {
+      while (impl_->doWork && !pipeline.aborted) {
+        Packet packet{packetPool};
+        if (auto err = readPacket(packet); err < EXIT_SUCCESS) {
+          if (err == AVERROR_EOF) {
+            pipeline.endOfFile = true;
+            break;
+          }
+          if (err == AVERROR_EXIT) {
+            break;
+          }
+          throwError(err);
+        }
 
-          fc(frame);
+        auto route = routeFor(packet.streamIndex());
+        auto accepted =
+            route && route->onPacket ? route->onPacket(packet) : pc(packet);
+        if (!accepted || !route || !route->decoder) {
+          continue;
+        }
+        auto key = packet.isKeyframe();
+        if (!pipeline.packets[packet.streamIndex()]->push(std::move(packet),
+                                                          key)) {
+          break;
         }
+      }
+    } catch (...) {
+      pipeline.setError(std::current_exception());
+    }
+    pipeline.closePackets();
+    pipeline.producerDone();
+  }};
+
+  try {
+    while (auto decoded = pipeline.frames.pop()) {
+      if (!impl_->doWork) {
+        break;
+      }
+      publish(*decoded->route, decoded->frame);
+      if (decoded->route->onFrame) {
+        decoded->route->onFrame(decoded->frame);
       } else {
-        throw ProcessingError(av_err2str(err));
+        fc(decoded->frame);
+      }
+    }
+  } catch (...) {
+    pipeline.setError(std::current_exception());
+  }
+
+  pipeline.abort();
+  demuxThread.join();
+  for (auto& thread : decodeThreads) {
+    thread.join();
+  }
+
+  if (pipeline.error) {
+    std::rethrow_exception(pipeline.error);
+  }
+  if (pipeline.endOfFile && impl_->doWork) {
+    throw EndOfFile("End of file reached");
+  }
+}
+
+PipelineStats Demuxer::pipelineStats() const {
+  PipelineStats stats;
+  stats.packetsDropped = impl_->packetsDropped;
+  stats.framesDropped = impl_->framesDropped;
+  return stats;
+}
+
+int Demuxer::readPacket(Packet& packet) noexcept {
+  if (!impl_->demuxerContext) {
+    return AVERROR(EINVAL);
+  }
+  av_packet_unref(packet);
+  // custom input tells if read would block, protocols are read as is
+  const auto& io = impl_->ioContext;
+  if (impl_->nonBlocking && io && io->buf_ptr >= io->buf_end &&
+      impl_->ioSource->available() == 0) {
+    return AVERROR(EAGAIN);
+  }
+  impl_->updateRequestTime();
+  auto err = av_read_frame(impl_->demuxerContext.get(), packet);
+  if (err < EXIT_SUCCESS && err != AVERROR_EOF) {
+    if (impl_->timedOut()) {
+      return AVERROR(ETIMEDOUT);
+    }
+    if (impl_->stopped()) {
+      return AVERROR_EXIT;
+    }
+  }
+  return err;
+}
+
+int Demuxer::nextFrame(Frame& frame) {
+  if (!impl_->demuxerContext) {
+    return AVERROR(EINVAL);
+  }
+
+  while (true) {
+    if (impl_->pendingRoute) {
+      auto err = impl_->pendingRoute->decoder->receiveFrame(frame);
+      if (err >= EXIT_SUCCESS) {
+        publish(*impl_->pendingRoute, frame);
+        return EXIT_SUCCESS;
+      }
+      if (err != AVERROR(EAGAIN) && err != AVERROR_EOF) {
+        return err;
+      }
+      impl_->pendingRoute = nullptr;
+    }
+
+    if (impl_->endOfFile) {
+      if (impl_->flushQueue.empty()) {
+        return AVERROR_EOF;
+      }
+      auto route = impl_->flushQueue.back();
+      impl_->flushQueue.pop_back();
+      // empty packet puts decoder into draining mode
+      Packet flushPacket;
+      if (auto err = route->decoder->sendPacket(flushPacket);
+          err < EXIT_SUCCESS) {
+        return err;
+      }
+      impl_->pendingRoute = route;
+      continue;
+    }
+
+    auto err = readPacket(impl_->pullPacket);
+    if (err == AVERROR_EOF) {
+      impl_->endOfFile = true;
+      for (const auto& route : impl_->routes) {
+        if (route.decoder) {
+          impl_->flushQueue.push_back(&route);
+        }
+      }
+      continue;
+    } else if (err < EXIT_SUCCESS) {
+      return err;
+    }
+
+    auto route = routeFor(impl_->pullPacket.streamIndex());
+    if (!route || !route->decoder) {
+      continue;
+    }
+    if (err = route->decoder->sendPacket(impl_->pullPacket);
+        err < EXIT_SUCCESS) {
+      return err;
+    }
+    impl_->pendingRoute = route;
+  }
+}
+
+DemuxerRange<Packet> Demuxer::packets() {
+  return DemuxerRange<Packet>{*this, &Demuxer::readPacket};
+}
+
+DemuxerRange<Frame> Demuxer::frames() {
+  return DemuxerRange<Frame>{*this, &Demuxer::nextFrame};
+}
+
+void Demuxer::throwError(int err) const {
+  if (err == AVERROR(EINVAL) && !impl_->demuxerContext) {
+    throw FFCppException("Demuxer not prepared");
+  }
+  Status::fromError(err).throwIfError();
+  throw ProcessingError(av_err2str(err));
+}
+
+PacketPool& Demuxer::beginStart() {
+  if (!impl_->demuxerContext) {
+    throw FFCppException("Demuxer not prepared");
+  }
+  impl_->timeout = std::chrono::seconds{COMMON_TIMEOUT};
+  impl_->restart();
+  return impl_->packetPoolFor(1);
+}
+
+bool Demuxer::running() const { return impl_->doWork; }
+
+void Demuxer::setNonBlocking(bool nonBlocking) {
+  if (!impl_->demuxerContext) {
+    throw FFCppException("Demuxer not prepared");
+  }
+  impl_->nonBlocking = nonBlocking;
+  if (nonBlocking) {
+    impl_->demuxerContext->flags |= AVFMT_FLAG_NONBLOCK;
+  } else {
+    impl_->demuxerContext->flags &= ~AVFMT_FLAG_NONBLOCK;
+  }
+}
+
+size_t Demuxer::subscribe(frame_callback fc,
+                          const SubscriberOptions& options) {
+  std::lock_guard<std::mutex> lg{impl_->subscribersMutex};
+  auto subscribers = std::atomic_load(&impl_->subscribers);
+  auto changed = subscribers ? std::make_shared<Subscribers>(*subscribers)
+                             : std::make_shared<Subscribers>();
+  auto id = impl_->nextSubscriberId++;
+  changed->push_back(std::make_shared<Subscriber>(id, std::move(fc), options));
+  std::atomic_store(&impl_->subscribers,
+                    std::shared_ptr<const Subscribers>{std::move(changed)});
+  return id;
+}
+
+void Demuxer::unsubscribe(size_t id) {
+  std::shared_ptr<Subscriber> subscriber;
+  {
+    std::lock_guard<std::mutex> lg{impl_->subscribersMutex};
+    auto subscribers = std::atomic_load(&impl_->subscribers);
+    auto changed = std::make_shared<Subscribers>();
+    if (subscribers) {
+      for (const auto& s : *subscribers) {
+        if (s->id == id) {
+          subscriber = s;
+        } else {
+          changed->push_back(s);
+        }
       }
     }
+    if (!subscriber) {
+      throw FFCppException("There is no subscriber with such id");
+    }
+    std::atomic_store(&impl_->subscribers,
+                      changed->empty() ? std::shared_ptr<const Subscribers>{}
+                                       : std::move(changed));
+  }
+  // deliver queued frames, frames published meanwhile are dropped
+  subscriber->frames.close();
+  subscriber->thread.join();
+}
+
+std::vector<SubscriberStats> Demuxer::subscriberStats() const {
+  std::vector<SubscriberStats> stats;
+  auto subscribers = std::atomic_load(&impl_->subscribers);
+  if (!subscribers) {
+    return stats;
+  }
+  for (const auto& subscriber : *subscribers) {
+    SubscriberStats subscriberStats;
+    subscriberStats.id = subscriber->id;
+    subscriberStats.delivered = subscriber->delivered;
+    subscriberStats.dropped = subscriber->dropped;
+    {
+      std::lock_guard<std::mutex> lg{subscriber->errorMutex};
+      subscriberStats.error = subscriber->error;
+    }
+    stats.push_back(std::move(subscriberStats));
   }
+  return stats;
 }
 
-void Demuxer::stop() { impl_->doWork = false; }
+void Demuxer::publish(const StreamRoute& route, Frame& frame) {
+  auto subscribers = std::atomic_load(&impl_->subscribers);
+  if (!subscribers) {
+    return;
+  }
+  const auto streamIndex = static_cast<int>(&route - impl_->routes.data());
+  for (const auto& subscriber : *subscribers) {
+    if (subscriber->options.streamIndex < 0 ||
+        subscriber->options.streamIndex == streamIndex) {
+      subscriber->frames.push(frame.ref());
+    }
+  }
+}
+
+const Demuxer::StreamRoute* Demuxer::routeFor(int streamIndex) const {
+  return static_cast<size_t>(streamIndex) < impl_->routes.size()
+             ? &impl_->routes[streamIndex]
+             : nullptr;
+}
+
+void Demuxer::stop() {
+  impl_->doWork = false;
+  impl_->stops++;
+  impl_->interrupt.store(INTERRUPT_STOPPED);
+}
 
 std::ostream& operator<<(std::ostream& ost, const Demuxer& dmxr) {
   ost << "Demuxer:\n";
@@ -0,0 +1,370 @@
+#include <ff_cpp/ff_demuxer_pool.h>
+#include <ff_cpp/ff_exception.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace ff_cpp {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Input {
+  size_t id{};
+  Demuxer* demuxer{};
+  frame_callback fc;
+  packet_callback pc;
+  Packet packet;
+  Frame frame;
+
+  // owned by worker which holds input or guarded by mutex of worker queue
+  Clock::time_point readyAt{};
+  Clock::time_point lastData{};
+  std::chrono::milliseconds backoff{};
+
+  std::atomic<bool> removed{};
+  // guarded by pool mutex
+  bool finished{};
+  std::exception_ptr error;
+
+  std::atomic<uint64_t> packets{};
+  std::atomic<uint64_t> frames{};
+  std::atomic<uint64_t> turns{};
+  std::atomic<uint64_t> wouldBlock{};
+  std::atomic<int64_t> busy{};
+  std::atomic<int64_t> lagSum{};
+  std::atomic<int64_t> maxLag{};
+};
+
+struct Worker {
+  std::mutex mutex;
+  std::deque<Input*> inputs;
+  std::thread thread;
+};
+
+int64_t microseconds(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+}  // namespace
+
+struct DemuxerPool::Impl {
+  DemuxerPoolOptions options;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<bool> running{};
+  std::atomic<uint64_t> steals{};
+
+  mutable std::mutex mutex;
+  // notified when input finished
+  std::condition_variable finished;
+  // notified when input added
+  std::condition_variable wakeup;
+  std::map<size_t, std::unique_ptr<Input>> inputs;
+  size_t nextId{};
+  size_t nextWorker{};
+
+  /**
+   * @brief Take ready input from own queue or steal it from other workers
+   */
+  Input* take(size_t worker) {
+    const auto now = Clock::now();
+    auto isReady = [now](const Input* input) {
+      return input->readyAt <= now || input->removed;
+    };
+    {
+      auto& own = *workers[worker];
+      std::lock_guard<std::mutex> lg{own.mutex};
+      auto input = std::find_if(own.inputs.begin(), own.inputs.end(), isReady);
+      if (input != own.inputs.end()) {
+        auto taken = *input;
+        own.inputs.erase(input);
+        return taken;
+      }
+    }
+    // steal from the back, owner of the queue reaches it last
+    for (size_t i = 1; i < workers.size(); i++) {
+      auto& other = *workers[(worker + i) % workers.size()];
+      std::lock_guard<std::mutex> lg{other.mutex};
+      auto input =
+          std::find_if(other.inputs.rbegin(), other.inputs.rend(), isReady);
+      if (input != other.inputs.rend()) {
+        auto taken = *input;
+        other.inputs.erase(std::next(input).base());
+        steals++;
+        return taken;
+      }
+    }
+    return nullptr;
+  }
+
+  void requeue(size_t worker, Input* input) {
+    auto& own = *workers[worker];
+    std::lock_guard<std::mutex> lg{own.mutex};
+    own.inputs.push_back(input);
+  }
+
+  void finish(Input* input, std::exception_ptr error) {
+    std::lock_guard<std::mutex> lg{mutex};
+    input->finished = true;
+    input->error = error;
+    input->demuxer->setNonBlocking(false);
+    finished.notify_all();
+  }
+
+  void dispatch(Input& input, const Demuxer::StreamRoute* route) {
+    auto& decoder = *route->decoder;
+    while (true) {
+      auto err = decoder.receiveFrame(input.frame);
+      if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+        return;
+      } else if (err < EXIT_SUCCESS) {
+        input.demuxer->throwError(err);
+      }
+      input.frames++;
+      input.demuxer->publish(*route, input.frame);
+      if (route->onFrame) {
+        route->onFrame(input.frame);
+      } else {
+        input.fc(input.frame);
+      }
+    }
+  }
+
+  /**
+   * @brief Decode frames left in decoders of finished input
+   */
+  void drain(Input& input) {
+    // empty packet puts decoder into draining mode
+    Packet flushPacket;
+    for (size_t i = 0; i < input.demuxer->streams().size(); i++) {
+      auto route = input.demuxer->routeFor(static_cast<int>(i));
+      if (!route || !route->decoder) {
+        continue;
+      }
+      if (auto err = route->decoder->sendPacket(flushPacket);
+          err < EXIT_SUCCESS) {
+        input.demuxer->throwError(err);
+      }
+      dispatch(input, route);
+    }
+  }
+
+  /**
+   * @brief Read up to packetsPerTurn packets of input
+   * @return false if input finished
+   */
+  bool service(Input& input, Clock::time_point start) {
+    auto& demuxer = *input.demuxer;
+    for (size_t i = 0; i < options.packetsPerTurn; i++) {
+      if (!demuxer.running()) {
+        return false;
+      }
+      auto err = demuxer.readPacket(input.packet);
+      if (err == AVERROR(EAGAIN)) {
+        input.wouldBlock++;
+        const auto now = Clock::now();
+        if (i > 0) {
+          input.lastData = start;
+        } else if (now - input.lastData > options.readTimeout) {
+          throw TimeoutElapsed("Timeout elapsed while read frame");
+        }
+        input.backoff = input.backoff.count()
+                            ? std::min(input.backoff * 2, options.maxBackoff)
+                            : options.minBackoff;
+        input.readyAt = now + input.backoff;
+        return true;
+      } else if (err == AVERROR_EOF) {
+        drain(input);
+        return false;
+      } else if (err == AVERROR_EXIT) {
+        return false;
+      } else if (err < EXIT_SUCCESS) {
+        demuxer.throwError(err);
+      }
+      input.packets++;
+
+      auto route = demuxer.routeFor(input.packet.streamIndex());
+      auto accepted = route && route->onPacket ? route->onPacket(input.packet)
+                      : input.pc               ? input.pc(input.packet)
+                                               : true;
+      if (!accepted || !route || !route->decoder) {
+        continue;
+      }
+      if (err = route->decoder->sendPacket(input.packet); err < EXIT_SUCCESS) {
+        demuxer.throwError(err);
+      }
+      dispatch(input, route);
+    }
+
+    input.lastData = start;
+    input.backoff = {};
+    input.readyAt = Clock::now();
+    return true;
+  }
+
+  void run(size_t worker) {
+    while (running) {
+      auto input = take(worker);
+      if (!input) {
+        std::unique_lock<std::mutex> lock{mutex};
+        wakeup.wait_for(lock, options.minBackoff);
+        continue;
+      }
+      if (input->removed) {
+        finish(input, nullptr);
+        continue;
+      }
+
+      const auto start = Clock::now();
+      const auto lag =
+          std::max<int64_t>(microseconds(start - input->readyAt), 0);
+      input->turns++;
+      input->lagSum += lag;
+      if (lag > input->maxLag) {
+        input->maxLag = lag;
+      }
+
+      auto active = false;
+      std::exception_ptr error;
+      try {
+        active = service(*input, start);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      input->busy += microseconds(Clock::now() - start);
+
+      if (active) {
+        requeue(worker, input);
+      } else {
+        finish(input, error);
+      }
+    }
+  }
+};
+
+DemuxerPool::DemuxerPool(const DemuxerPoolOptions& options) {
+  impl_ = std::make_unique<Impl>();
+  impl_->options = options;
+  impl_->options.packetsPerTurn = std::max<size_t>(options.packetsPerTurn, 1);
+  impl_->options.minBackoff =
+      std::max(options.minBackoff, std::chrono::milliseconds{1});
+  impl_->options.maxBackoff =
+      std::max(options.maxBackoff, impl_->options.minBackoff);
+
+  auto threads = options.threads
+                     ? options.threads
+                     : std::max(std::thread::hardware_concurrency(), 1u);
+  impl_->running = true;
+  for (unsigned int i = 0; i < threads; i++) {
+    impl_->workers.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < impl_->workers.size(); i++) {
+    impl_->workers[i]->thread = std::thread{[this, i]() { impl_->run(i); }};
+  }
+}
+
+DemuxerPool::~DemuxerPool() { stop(); }
+
+size_t DemuxerPool::add(Demuxer& demuxer, frame_callback fc,
+                        packet_callback pc) {
+  if (!impl_->running) {
+    throw FFCppException("Demuxer pool stopped");
+  }
+  demuxer.beginStart();
+  demuxer.setNonBlocking(true);
+
+  auto input = std::make_unique<Input>();
+  input->demuxer = &demuxer;
+  input->fc = std::move(fc);
+  input->pc = std::move(pc);
+  input->readyAt = Clock::now();
+  input->lastData = input->readyAt;
+
+  auto pooled = input.get();
+  size_t worker{};
+  {
+    std::lock_guard<std::mutex> lg{impl_->mutex};
+    input->id = impl_->nextId++;
+    impl_->inputs[input->id] = std::move(input);
+    worker = impl_->nextWorker++ % impl_->workers.size();
+  }
+  impl_->requeue(worker, pooled);
+  impl_->wakeup.notify_all();
+  return pooled->id;
+}
+
+void DemuxerPool::remove(size_t id) {
+  std::unique_lock<std::mutex> lock{impl_->mutex};
+  auto input = impl_->inputs.find(id);
+  if (input == impl_->inputs.end()) {
+    throw FFCppException("There is no input with such id");
+  }
+  input->second->removed = true;
+  impl_->wakeup.notify_all();
+  impl_->finished.wait(lock, [&input]() { return input->second->finished; });
+  impl_->inputs.erase(input);
+}
+
+void DemuxerPool::wait() {
+  std::unique_lock<std::mutex> lock{impl_->mutex};
+  impl_->finished.wait(lock, [this]() {
+    return std::all_of(
+        impl_->inputs.begin(), impl_->inputs.end(),
+        [](const auto& input) { return input.second->finished; });
+  });
+}
+
+void DemuxerPool::stop() {
+  if (!impl_->running.exchange(false)) {
+    return;
+  }
+  impl_->wakeup.notify_all();
+  for (auto& worker : impl_->workers) {
+    worker->thread.join();
+    worker->inputs.clear();
+  }
+
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  for (auto& input : impl_->inputs) {
+    if (!input.second->finished) {
+      input.second->finished = true;
+      input.second->demuxer->setNonBlocking(false);
+    }
+  }
+  impl_->finished.notify_all();
+}
+
+DemuxerPoolStats DemuxerPool::stats() const {
+  DemuxerPoolStats stats;
+  stats.steals = impl_->steals;
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  for (const auto& pooled : impl_->inputs) {
+    const auto& input = *pooled.second;
+    PooledInputStats inputStats;
+    inputStats.id = input.id;
+    inputStats.demuxer = input.demuxer;
+    inputStats.packets = input.packets;
+    inputStats.frames = input.frames;
+    inputStats.turns = input.turns;
+    inputStats.wouldBlock = input.wouldBlock;
+    inputStats.busy = std::chrono::microseconds{input.busy};
+    if (inputStats.turns) {
+      inputStats.averageLag = std::chrono::microseconds{
+          input.lagSum / static_cast<int64_t>(inputStats.turns)};
+    }
+    inputStats.maxLag = std::chrono::microseconds{input.maxLag};
+    inputStats.finished = input.finished;
+    inputStats.error = input.error;
+    stats.inputs.push_back(std::move(inputStats));
+  }
+  return stats;
+}
+
+}  // namespace ff_cpp
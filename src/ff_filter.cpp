@@ -133,24 +133,49 @@ Filter& Filter::operator=(Filter&& other) {
 }
 
 Frame Filter::filter(Frame& frm, bool keepRef) {
+  Frame outFrm;
+  tryFilter(frm, outFrm, keepRef).throwIfError();
+  return outFrm;
+}
+
+Status Filter::tryFilter(Frame& frm, Frame& out, bool keepRef) noexcept {
   int flags = AV_BUFFERSRC_FLAG_PUSH;
   if (keepRef) {
     flags |= AV_BUFFERSRC_FLAG_KEEP_REF;
   }
   int ret = av_buffersrc_add_frame_flags(impl_->bufferSrcCtx, frm, flags);
   if (ret < EXIT_SUCCESS) {
-    throw ProcessingError("Unable to add frame buffer, reason: " +
-                          ff_cpp::av_make_error_string(ret));
+    return Status{StatusCode::ProcessingError, ret,
+                  "Unable to add frame buffer"};
   }
 
-  Frame outFrm;
+  AVFrame* outFrm = out;
+  av_frame_unref(outFrm);
   ret = av_buffersink_get_frame_flags(impl_->bufferSinkCtx, outFrm, 0);
   if (ret < EXIT_SUCCESS) {
-    throw ProcessingError("Unable to get frame from sink, reason: " +
-                          ff_cpp::av_make_error_string(ret));
+    return Status{ret == AVERROR(EAGAIN) ? StatusCode::TryAgain
+                                         : StatusCode::ProcessingError,
+                  ret, "Unable to get frame from sink"};
+  }
+  return Status{};
+}
+
+Frame Filter::filter(Frame& frm, FramePool& pool, bool keepRef) {
+  AVFrame* inFrm = frm;
+  if (!keepRef || inFrm->buf[0]) {
+    return filter(frm, keepRef);
   }
 
-  return outFrm;
+  Frame pooledFrm{pool, frm.width(), frm.height(), frm.format()};
+  int ret = av_frame_copy(pooledFrm, inFrm);
+  if (ret >= EXIT_SUCCESS) {
+    ret = av_frame_copy_props(pooledFrm, inFrm);
+  }
+  if (ret < EXIT_SUCCESS) {
+    throw FFCppException("Unable to copy frame, reason: " +
+                         ff_cpp::av_make_error_string(ret));
+  }
+  return filter(pooledFrm);
 }
 
 }  // namespace ff_cpp
\ No newline at end of file
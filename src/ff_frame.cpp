@@ -1,7 +1,12 @@
 #include <ff_cpp/ff_exception.h>
 #include <ff_cpp/ff_frame.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
 #include <ostream>
+#include <tuple>
 
 namespace ff_cpp {
 
@@ -25,6 +30,97 @@ struct Frame::Impl {
                                    av_make_error_string(ret));
     }
   }
+
+  /**
+   * @brief make frame reference to the src frame data
+   */
+  void ref(const AVFrame* src) {
+    av_frame_unref(frame.get());
+    // frame without image, av_frame_ref would fail to alloc buffer for it
+    if (!src->buf[0] && !src->data[0]) {
+      frame->width = src->width;
+      frame->height = src->height;
+      frame->format = src->format;
+      av_frame_copy_props(frame.get(), src);
+      return;
+    }
+    if (auto ret = av_frame_ref(frame.get(), src); ret < EXIT_SUCCESS) {
+      throw ff_cpp::FFCppException("Unable to ref frame, reason: " +
+                                   av_make_error_string(ret));
+    }
+  }
+};
+
+static void avBufferPoolDeleter(AVBufferPool* pool) {
+  if (pool) {
+    av_buffer_pool_uninit(&pool);
+  }
+}
+using UniqBufferPool =
+    std::unique_ptr<AVBufferPool, decltype(avBufferPoolDeleter)*>;
+
+struct FramePool::Impl {
+  using Key = std::tuple<int, int, int, int>;
+
+  std::mutex mutex;
+  std::map<Key, UniqBufferPool> pools;
+  std::atomic<uint64_t> requests{};
+  std::atomic<uint64_t> misses{};
+
+  static AVBufferRef* allocBuffer(void* opaque, int size) {
+    static_cast<Impl*>(opaque)->misses++;
+    return av_buffer_alloc(size);
+  }
+
+  AVBufferPool* pool(int width, int height, int format, int align, int size) {
+    std::lock_guard<std::mutex> lg{mutex};
+    Key key{width, height, format, align};
+    auto pool = pools.find(key);
+    if (pool == pools.end()) {
+      UniqBufferPool bufferPool{
+          av_buffer_pool_init2(size, this, allocBuffer, nullptr),
+          avBufferPoolDeleter};
+      if (!bufferPool) {
+        return nullptr;
+      }
+      pool = pools.emplace(key, std::move(bufferPool)).first;
+    }
+    return pool->second.get();
+  }
+
+  void getBuffer(AVFrame* frame, int width, int height, int format,
+                 int align) {
+    auto size = av_image_get_buffer_size(static_cast<AVPixelFormat>(format),
+                                         width, height, align);
+    if (size < EXIT_SUCCESS) {
+      throw ff_cpp::FFCppException("Unable to alloc buffer, reason: " +
+                                   av_make_error_string(size));
+    }
+
+    auto bufferPool = pool(width, height, format, align, size);
+    if (!bufferPool) {
+      throw ff_cpp::FFCppException("Unable to create buffer pool");
+    }
+    requests++;
+    frame->buf[0] = av_buffer_pool_get(bufferPool);
+    if (!frame->buf[0]) {
+      throw ff_cpp::FFCppException("Unable to alloc buffer, reason: " +
+                                   av_make_error_string(AVERROR(ENOMEM)));
+    }
+
+    av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data,
+                         static_cast<AVPixelFormat>(format), width, height,
+                         align);
+    frame->extended_data = frame->data;
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+
+    // No pallet fot y8 images
+    if (format == AV_PIX_FMT_GRAY8) {
+      frame->data[1] = nullptr;
+    }
+  }
 };
 
 Frame::Frame() { impl_ = std::make_unique<Impl>(); }
@@ -34,6 +130,11 @@ Frame::Frame(int width, int height, int format, int align) {
   impl_->getBuffer(width, height, format, align);
 }
 
+Frame::Frame(FramePool& pool, int width, int height, int format, int align) {
+  impl_ = std::make_unique<Impl>();
+  pool.impl_->getBuffer(impl_->frame.get(), width, height, format, align);
+}
+
 Frame::Frame(const uint8_t* ptr, int width, int height, int format, int align) {
   impl_ = std::make_unique<Impl>();
   av_image_fill_arrays(impl_->frame->data, impl_->frame->linesize, ptr,
@@ -51,10 +152,96 @@ Frame::Frame(const uint8_t* ptr, int width, int height, int format, int align) {
   }
 }
 
+static void adoptedBufferFree(void* opaque, uint8_t* data) {
+  std::unique_ptr<buffer_deleter> deleter{static_cast<buffer_deleter*>(opaque)};
+  (*deleter)(data);
+}
+
+Frame::Frame(uint8_t* ptr, int width, int height, int format, int align,
+             buffer_deleter deleter) {
+  auto size = av_image_get_buffer_size(static_cast<AVPixelFormat>(format),
+                                       width, height, align);
+  if (size < EXIT_SUCCESS) {
+    deleter(ptr);
+    throw ff_cpp::FFCppException("Wrong buffer parameters, reason: " +
+                                 av_make_error_string(size));
+  }
+
+  auto opaque = new buffer_deleter{std::move(deleter)};
+  auto buffer = av_buffer_create(ptr, size, adoptedBufferFree, opaque, 0);
+  if (!buffer) {
+    (*opaque)(ptr);
+    delete opaque;
+    throw ff_cpp::FFCppException("Unable to create buffer, reason: " +
+                                 av_make_error_string(AVERROR(ENOMEM)));
+  }
+
+  impl_ = std::make_unique<Impl>();
+  impl_->frame->buf[0] = buffer;
+  av_image_fill_arrays(impl_->frame->data, impl_->frame->linesize, ptr,
+                       static_cast<AVPixelFormat>(format), width, height,
+                       align);
+  impl_->frame->extended_data = impl_->frame->data;
+  impl_->frame->width = width;
+  impl_->frame->height = height;
+  impl_->frame->format = format;
+  impl_->frame->key_frame = 1;
+
+  // No pallet fot y8 images
+  if (format == AV_PIX_FMT_GRAY8) {
+    impl_->frame->data[1] = nullptr;
+  }
+}
+
+Frame::Frame(const Frame& other) {
+  impl_ = std::make_unique<Impl>();
+  impl_->ref(other.impl_->frame.get());
+}
+
 Frame::Frame(Frame&& other) { impl_ = std::move(other.impl_); }
 
 Frame::~Frame() = default;
 
+Frame& Frame::operator=(const Frame& other) {
+  if (this == &other) {
+    return *this;
+  }
+  if (!impl_) {
+    impl_ = std::make_unique<Impl>();
+  }
+  impl_->ref(other.impl_->frame.get());
+  return *this;
+}
+
+Frame& Frame::operator=(Frame&& other) {
+  if (this == &other) {
+    return *this;
+  }
+  impl_ = std::move(other.impl_);
+  return *this;
+}
+
+Frame Frame::ref() const { return Frame{*this}; }
+
+Frame Frame::clone(int align) const {
+  Frame copy;
+  auto src = impl_->frame.get();
+  auto dst = copy.impl_->frame.get();
+  if (src->data[0]) {
+    copy.impl_->getBuffer(src->width, src->height, src->format, align);
+    if (auto ret = av_frame_copy(dst, src); ret < EXIT_SUCCESS) {
+      throw ff_cpp::FFCppException("Unable to copy frame, reason: " +
+                                   av_make_error_string(ret));
+    }
+  } else {
+    dst->width = src->width;
+    dst->height = src->height;
+    dst->format = src->format;
+  }
+  av_frame_copy_props(dst, src);
+  return copy;
+}
+
 int Frame::width() const { return impl_->frame->width; }
 
 int Frame::height() const { return impl_->frame->height; }
@@ -75,8 +262,49 @@ uint8_t** Frame::data() const { return impl_->frame->data; }
 
 int* Frame::linesize() const { return impl_->frame->linesize; }
 
+MotionVectors Frame::motionVectors() const {
+  auto sideData =
+      av_frame_get_side_data(impl_->frame.get(), AV_FRAME_DATA_MOTION_VECTORS);
+  if (!sideData) {
+    return {};
+  }
+  return MotionVectors{reinterpret_cast<const AVMotionVector*>(sideData->data),
+                       sideData->size / sizeof(AVMotionVector)};
+}
+
+double motionScore(const Frame& frame) {
+  auto frameArea = static_cast<double>(frame.width()) * frame.height();
+  if (frameArea <= 0) {
+    return 0;
+  }
+  double score{};
+  double blocksArea{};
+  for (const auto& mv : frame.motionVectors()) {
+    auto scale = mv.motion_scale ? mv.motion_scale : 1;
+    auto length = std::hypot(static_cast<double>(mv.motion_x) / scale,
+                             static_cast<double>(mv.motion_y) / scale);
+    score += length * mv.w * mv.h;
+    blocksArea += static_cast<double>(mv.w) * mv.h;
+  }
+  // bi-predicted block has forward and backward vectors, so blocks could
+  // cover frame twice, uncovered area counts as still one
+  return score / std::max(frameArea, blocksArea);
+}
+
 Frame::operator AVFrame*() { return impl_->frame.get(); }
 
+FramePool::FramePool() { impl_ = std::make_unique<Impl>(); }
+
+FramePool::~FramePool() = default;
+
+FramePoolStats FramePool::stats() const {
+  FramePoolStats stats;
+  stats.misses = impl_->misses;
+  stats.hits = impl_->requests - stats.misses;
+  stats.peakBuffers = stats.misses;
+  return stats;
+}
+
 std::ostream& operator<<(std::ostream& ost, const Frame& frame) {
   ost << "Frame:\n";
   ost << "\tWidth: " << frame.width() << "\n";
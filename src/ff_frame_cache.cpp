@@ -0,0 +1,257 @@
+#include <ff_cpp/ff_exception.h>
+#include <ff_cpp/ff_frame_cache.h>
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <iterator>
+#include <list>
+#include <map>
+
+namespace ff_cpp {
+
+struct FrameCache::Impl {
+  /**
+   * @brief Decoded frames of one GOP sorted by pts, GOP which doesn't fit
+   * memory limit keeps only frames around the pts it was decoded for
+   */
+  struct Gop {
+    size_t streamIndex{};
+    size_t keyframe{};
+    std::deque<Frame> frames;
+    size_t bytes{};
+    // frames before the first cached one were dropped
+    bool headDropped{};
+    // pts of the first frame dropped after the last cached one
+    int64_t end{std::numeric_limits<int64_t>::max()};
+
+    /**
+     * @brief True if pts is before GOP or frame displayed at pts is cached
+     */
+    bool covers(int64_t pts) const {
+      return frames.empty() ||
+             ((!headDropped || pts >= frames.front().pts()) && pts < end);
+    }
+  };
+  using GopKey = std::pair<size_t, size_t>;
+
+  explicit Impl(Demuxer& dmxr) : demuxer(dmxr) {}
+
+  Demuxer& demuxer;
+  size_t maxBytes{};
+  std::map<size_t, KeyframeIndex> indexes;
+  // most recently used GOP is in front
+  std::list<Gop> gops;
+  std::map<GopKey, std::list<Gop>::iterator> lookup;
+  FrameCacheStats stats;
+
+  static size_t frameBytes(const Frame& frame) {
+    auto bytes = av_image_get_buffer_size(
+        static_cast<AVPixelFormat>(frame.format()), frame.width(),
+        frame.height(), 1);
+    return static_cast<size_t>(std::max(bytes, 0));
+  }
+
+  const KeyframeIndex& indexFor(size_t streamIndex) {
+    auto index = indexes.find(streamIndex);
+    if (index == indexes.end()) {
+      auto keyframeIndex = demuxer.keyframeIndex(streamIndex);
+      index = indexes.emplace(streamIndex, std::move(keyframeIndex)).first;
+    }
+    return index->second;
+  }
+
+  /**
+   * @brief Cached or decoded GOP which covers pts, it becomes most recently
+   * used one. Partially cached GOP which doesn't cover pts is decoded again
+   */
+  const Gop& gop(size_t streamIndex, size_t keyframe, int64_t pts,
+                 bool& decoded) {
+    auto cached = lookup.find({streamIndex, keyframe});
+    if (cached != lookup.end()) {
+      if (cached->second->covers(pts)) {
+        gops.splice(gops.begin(), gops, cached->second);
+        return gops.front();
+      }
+      erase(cached->second);
+    }
+
+    decoded = true;
+    gops.push_front(decode(streamIndex, keyframe, pts));
+    lookup[{streamIndex, keyframe}] = gops.begin();
+    stats.bytes += gops.front().bytes;
+    stats.frames += gops.front().frames.size();
+    evict();
+    return gops.front();
+  }
+
+  /**
+   * @brief Decode GOP, if its frames exceed memory limit, frames before pts
+   * are dropped from the front while frames up to pts are decoded, and
+   * decoding stops at the first frame after pts which doesn't fit
+   */
+  Gop decode(size_t streamIndex, size_t keyframe, int64_t pts) {
+    const auto& index = indexFor(streamIndex);
+    auto decoder = demuxer.routeFor(static_cast<int>(streamIndex))->decoder;
+    const auto stream = static_cast<int>(streamIndex);
+    const auto end = keyframe + 1 < index.timestamps.size()
+                         ? index.timestamps[keyframe + 1]
+                         : std::numeric_limits<int64_t>::max();
+    demuxer.seek(index.timestamps[keyframe], AVSEEK_FLAG_BACKWARD, stream);
+
+    Gop gop;
+    gop.streamIndex = streamIndex;
+    gop.keyframe = keyframe;
+    Packet packet;
+    // empty packet puts decoder into draining mode
+    Packet flushPacket;
+    auto draining = false;
+    auto full = false;
+    while (!draining && !full) {
+      auto err = demuxer.readPacket(packet);
+      if (err < EXIT_SUCCESS && err != AVERROR_EOF) {
+        demuxer.throwError(err);
+      }
+      if (err == AVERROR_EOF ||
+          (packet.streamIndex() == stream && packet.dts() != AV_NOPTS_VALUE &&
+           packet.dts() >= end)) {
+        draining = true;
+      } else if (packet.streamIndex() != stream) {
+        continue;
+      }
+      if (err = decoder->sendPacket(draining ? flushPacket : packet);
+          err < EXIT_SUCCESS) {
+        demuxer.throwError(err);
+      }
+
+      while (true) {
+        Frame frame;
+        err = decoder->receiveFrame(frame);
+        if (err == AVERROR(EAGAIN) || err == AVERROR_EOF) {
+          break;
+        } else if (err < EXIT_SUCCESS) {
+          demuxer.throwError(err);
+        }
+        const auto bytes = frameBytes(frame);
+        if (!gop.frames.empty() && gop.bytes + bytes > maxBytes) {
+          if (frame.pts() > pts) {
+            gop.end = frame.pts();
+            full = true;
+            break;
+          }
+          while (!gop.frames.empty() && gop.bytes + bytes > maxBytes) {
+            gop.bytes -= frameBytes(gop.frames.front());
+            gop.frames.pop_front();
+            gop.headDropped = true;
+          }
+        }
+        gop.bytes += bytes;
+        gop.frames.push_back(std::move(frame));
+      }
+    }
+    // decoder is drained or stopped in the middle of GOP, it must be
+    // flushed before next use
+    decoder->flush();
+
+    std::sort(gop.frames.begin(), gop.frames.end(),
+              [](const Frame& l, const Frame& r) { return l.pts() < r.pts(); });
+    return gop;
+  }
+
+  void erase(std::list<Gop>::iterator gop) {
+    stats.bytes -= gop->bytes;
+    stats.frames -= gop->frames.size();
+    lookup.erase({gop->streamIndex, gop->keyframe});
+    gops.erase(gop);
+  }
+
+  /**
+   * @brief Evict least recently used GOPs, GOPs next to the one used last
+   * are evicted after all others, so scrubbing around it stays in cache
+   */
+  void evict() {
+    const auto& cursor = gops.front();
+    auto isNeighbour = [&cursor](const Gop& gop) {
+      return gop.streamIndex == cursor.streamIndex &&
+             (gop.keyframe + 1 == cursor.keyframe ||
+              cursor.keyframe + 1 == gop.keyframe);
+    };
+    while (stats.bytes > maxBytes && gops.size() > 1) {
+      auto victim = std::prev(gops.end());
+      for (auto gop = victim; gop != gops.begin(); --gop) {
+        if (!isNeighbour(*gop)) {
+          victim = gop;
+          break;
+        }
+      }
+      erase(victim);
+      stats.evictions++;
+    }
+    stats.gops = gops.size();
+  }
+};
+
+FrameCache::FrameCache(Demuxer& demuxer, size_t maxBytes) {
+  impl_ = std::make_unique<Impl>(demuxer);
+  impl_->maxBytes = maxBytes;
+}
+
+FrameCache::~FrameCache() {}
+
+Frame FrameCache::frameAt(size_t streamIndex, int64_t pts) {
+  const auto route = impl_->demuxer.routeFor(static_cast<int>(streamIndex));
+  if (!route) {
+    throw NoStream("There is no stream with such index");
+  }
+  if (!route->decoder) {
+    throw FFCppException("There is no decoder for the stream");
+  }
+  const auto& timestamps = impl_->indexFor(streamIndex).timestamps;
+  if (timestamps.empty()) {
+    // nothing to split stream by, so there is nothing to cache
+    impl_->stats.misses++;
+    return impl_->demuxer.frameAt(streamIndex, pts);
+  }
+
+  // keyframes are indexed by decoding timestamps, frame displayed at pts
+  // could belong to GOP before the found one
+  auto keyframe = static_cast<size_t>(
+      std::max(std::upper_bound(timestamps.begin(), timestamps.end(), pts),
+               timestamps.begin() + 1) -
+      timestamps.begin() - 1);
+  auto decoded = false;
+  const auto* gop = &impl_->gop(streamIndex, keyframe, pts, decoded);
+  while ((gop->frames.empty() || pts < gop->frames.front().pts()) &&
+         !gop->headDropped && gop->keyframe > 0) {
+    gop = &impl_->gop(streamIndex, gop->keyframe - 1, pts, decoded);
+  }
+  decoded ? impl_->stats.misses++ : impl_->stats.hits++;
+  if (gop->frames.empty()) {
+    throw EndOfFile("There is no frame in the stream");
+  }
+
+  auto frame = std::upper_bound(
+      gop->frames.begin(), gop->frames.end(), pts,
+      [](int64_t value, const Frame& f) { return value < f.pts(); });
+  return frame != gop->frames.begin() ? (frame - 1)->ref()
+                                      : gop->frames.front().ref();
+}
+
+void FrameCache::clear() {
+  impl_->gops.clear();
+  impl_->lookup.clear();
+  impl_->stats.bytes = 0;
+  impl_->stats.frames = 0;
+  impl_->stats.gops = 0;
+}
+
+FrameCacheStats FrameCache::stats() const {
+  auto stats = impl_->stats;
+  if (stats.hits + stats.misses > 0) {
+    stats.hitRate = static_cast<double>(stats.hits) /
+                    static_cast<double>(stats.hits + stats.misses);
+  }
+  return stats;
+}
+
+}  // namespace ff_cpp
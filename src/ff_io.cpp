@@ -0,0 +1,485 @@
+#include <ff_cpp/ff_exception.h>
+#include <ff_cpp/ff_io.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ff_cpp {
+
+/**
+ * @brief Read only memory mapping of whole file
+ */
+class FileMapping {
+ public:
+  explicit FileMapping(const std::string& path) {
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      throw BadInput("Unable to open file", path);
+    }
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file_, &fileSize)) {
+      CloseHandle(file_);
+      throw BadInput("Unable to get file size", path);
+    }
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    if (size_ == 0) {
+      return;
+    }
+    mapping_ =
+        CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) {
+      CloseHandle(file_);
+      throw BadInput("Unable to map file", path);
+    }
+    data_ = static_cast<const uint8_t*>(
+        MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+      CloseHandle(mapping_);
+      CloseHandle(file_);
+      throw BadInput("Unable to map file", path);
+    }
+#else
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw BadInput(std::string{"Unable to open file: "} + strerror(errno),
+                     path);
+    }
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) != 0) {
+      close(fd);
+      throw BadInput(std::string{"Unable to get file size: "} +
+                         strerror(errno),
+                     path);
+    }
+    size_ = static_cast<size_t>(fileStat.st_size);
+    if (size_ == 0) {
+      close(fd);
+      return;
+    }
+    auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      throw BadInput(std::string{"Unable to map file: "} + strerror(errno),
+                     path);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+#endif
+  }
+
+  ~FileMapping() {
+#ifdef _WIN32
+    if (data_) {
+      UnmapViewOfFile(data_);
+      CloseHandle(mapping_);
+    }
+    CloseHandle(file_);
+#else
+    if (data_) {
+      munmap(const_cast<uint8_t*>(data_), size_);
+    }
+#endif
+  }
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  FileMapping(const FileMapping&) = delete;
+  FileMapping& operator=(const FileMapping&) = delete;
+
+#ifdef _WIN32
+  HANDLE file_{INVALID_HANDLE_VALUE};
+  HANDLE mapping_{};
+#endif
+  const uint8_t* data_{};
+  size_t size_{};
+};
+
+struct MemorySource::Impl {
+  std::string name;
+  std::unique_ptr<FileMapping> mapping;
+  const uint8_t* data{};
+  size_t size{};
+  size_t position{};
+};
+
+MemorySource::MemorySource(const uint8_t* data, size_t size,
+                           const std::string& name) {
+  impl_ = std::make_unique<Impl>();
+  impl_->name = name;
+  impl_->data = data;
+  impl_->size = size;
+}
+
+MemorySource::MemorySource(const std::string& path) {
+  impl_ = std::make_unique<Impl>();
+  impl_->name = path;
+  impl_->mapping = std::make_unique<FileMapping>(path);
+  impl_->data = impl_->mapping->data();
+  impl_->size = impl_->mapping->size();
+}
+
+MemorySource::~MemorySource() = default;
+
+const uint8_t* MemorySource::data() const { return impl_->data; }
+
+size_t MemorySource::size() const { return impl_->size; }
+
+int MemorySource::read(uint8_t* buf, int size) {
+  if (impl_->position >= impl_->size) {
+    return AVERROR_EOF;
+  }
+  auto bytes = std::min(static_cast<size_t>(size),
+                        impl_->size - impl_->position);
+  std::memcpy(buf, impl_->data + impl_->position, bytes);
+  impl_->position += bytes;
+  return static_cast<int>(bytes);
+}
+
+int64_t MemorySource::seek(int64_t offset, int whence) {
+  int64_t position{};
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return static_cast<int64_t>(impl_->size);
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = static_cast<int64_t>(impl_->position) + offset;
+      break;
+    case SEEK_END:
+      position = static_cast<int64_t>(impl_->size) + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if (position < 0) {
+    return AVERROR(EINVAL);
+  }
+  impl_->position = static_cast<size_t>(position);
+  return position;
+}
+
+const std::string& MemorySource::name() const { return impl_->name; }
+
+/**
+ * @brief Read only file with positional reads
+ */
+class InputFile {
+ public:
+  explicit InputFile(const std::string& path) {
+#ifdef _WIN32
+    fd_ = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    fd_ = open(path.c_str(), O_RDONLY);
+#endif
+    if (fd_ < 0) {
+      throw BadInput(std::string{"Unable to open file: "} + strerror(errno),
+                     path);
+    }
+#ifdef _WIN32
+    size_ = _lseeki64(fd_, 0, SEEK_END);
+#else
+    size_ = lseek(fd_, 0, SEEK_END);
+#endif
+    if (size_ < 0) {
+      auto err = errno;
+      closeFile();
+      throw BadInput(std::string{"Unable to get file size: "} + strerror(err),
+                     path);
+    }
+  }
+
+  ~InputFile() { closeFile(); }
+
+  int64_t size() const { return size_; }
+
+  /**
+   * @brief Read up to size bytes starting at offset
+   *
+   * @return number of read bytes or negative AVERROR
+   */
+  int64_t readAt(uint8_t* buf, size_t size, int64_t offset) {
+    size_t total{};
+    while (total < size) {
+#ifdef _WIN32
+      // file is read only from one thread, so seek + read is enough here
+      if (_lseeki64(fd_, offset + total, SEEK_SET) < 0) {
+        return AVERROR(errno);
+      }
+      auto ret = _read(fd_, buf + total,
+                       static_cast<unsigned int>(std::min<size_t>(
+                           size - total, 1u << 30)));
+#else
+      auto ret = pread(fd_, buf + total, size - total,
+                       static_cast<off_t>(offset + total));
+#endif
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return AVERROR(errno);
+      }
+      if (ret == 0) {
+        break;
+      }
+      total += static_cast<size_t>(ret);
+    }
+    return static_cast<int64_t>(total);
+  }
+
+ private:
+  InputFile(const InputFile&) = delete;
+  InputFile& operator=(const InputFile&) = delete;
+
+  void closeFile() {
+    if (fd_ >= 0) {
+#ifdef _WIN32
+      _close(fd_);
+#else
+      close(fd_);
+#endif
+      fd_ = -1;
+    }
+  }
+
+  int fd_{-1};
+  int64_t size_{};
+};
+
+/**
+ * @brief Blocks in window are consecutive and cover [blocks.front().offset,
+ * nextFetch). Background thread appends blocks until window is full, reader
+ * drops blocks behind its position. Seek outside of the window restarts
+ * prefetching from the new position
+ */
+struct PrefetchSource::Impl {
+  struct Block {
+    int64_t offset{};
+    std::vector<uint8_t> data;
+  };
+
+  std::string name;
+  PrefetchOptions options;
+  std::unique_ptr<InputFile> file;
+
+  std::mutex mutex;
+  std::condition_variable fetched;
+  std::condition_variable consumed;
+  std::deque<Block> blocks;
+  std::vector<std::vector<uint8_t>> spareBuffers;
+  int64_t position{};
+  int64_t nextFetch{};
+  uint64_t generation{};
+  int error{};
+  bool stopping{};
+  std::thread thread;
+
+  std::atomic<uint64_t> bytesRead{};
+  std::atomic<uint64_t> bytesConsumed{};
+  std::atomic<uint64_t> stalls{};
+  std::atomic<int64_t> stallTime{};
+  std::atomic<int64_t> readTime{};
+
+  void fetchLoop() {
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true) {
+      consumed.wait(lock, [this] {
+        return stopping || (!error && nextFetch < file->size() &&
+                            blocks.size() < options.windowBlocks);
+      });
+      if (stopping) {
+        return;
+      }
+
+      auto offset = nextFetch;
+      auto fetchGeneration = generation;
+      std::vector<uint8_t> buffer;
+      if (!spareBuffers.empty()) {
+        buffer = std::move(spareBuffers.back());
+        spareBuffers.pop_back();
+      }
+      lock.unlock();
+
+      buffer.resize(options.blockSize);
+      auto start = std::chrono::steady_clock::now();
+      auto ret = file->readAt(buffer.data(), buffer.size(), offset);
+      readTime += std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+      lock.lock();
+      if (fetchGeneration != generation) {
+        spareBuffers.push_back(std::move(buffer));
+        continue;
+      }
+      if (ret <= 0) {
+        // unexpected end of file is reported as error too
+        error = ret < 0 ? static_cast<int>(ret) : AVERROR_EOF;
+      } else {
+        bytesRead += static_cast<uint64_t>(ret);
+        buffer.resize(static_cast<size_t>(ret));
+        blocks.push_back(Block{offset, std::move(buffer)});
+        nextFetch += ret;
+      }
+      fetched.notify_all();
+    }
+  }
+
+  void dropBlock() {
+    spareBuffers.push_back(std::move(blocks.front().data));
+    blocks.pop_front();
+    consumed.notify_all();
+  }
+
+  /**
+   * @brief drop blocks behind current position
+   *
+   * @return true if block containing current position is fetched
+   */
+  bool positionFetched() {
+    while (!blocks.empty() &&
+           blocks.front().offset +
+                   static_cast<int64_t>(blocks.front().data.size()) <=
+               position) {
+      dropBlock();
+    }
+    return !blocks.empty() && blocks.front().offset <= position;
+  }
+
+  /**
+   * @brief restart prefetching from current position if it is outside of the
+   * window
+   */
+  void updateWindow() {
+    positionFetched();
+    auto windowStart = blocks.empty() ? nextFetch : blocks.front().offset;
+    auto windowEnd = windowStart + static_cast<int64_t>(options.blockSize *
+                                                        options.windowBlocks);
+    if (position < windowStart || position >= windowEnd) {
+      while (!blocks.empty()) {
+        dropBlock();
+      }
+      generation++;
+      nextFetch = position;
+      error = 0;
+      consumed.notify_all();
+    }
+  }
+};
+
+PrefetchSource::PrefetchSource(const std::string& path,
+                               const PrefetchOptions& options) {
+  impl_ = std::make_unique<Impl>();
+  impl_->name = path;
+  impl_->options = options;
+  impl_->options.blockSize = std::max<size_t>(impl_->options.blockSize, 4096);
+  impl_->options.windowBlocks =
+      std::max<size_t>(impl_->options.windowBlocks, 1);
+  impl_->file = std::make_unique<InputFile>(path);
+  impl_->thread = std::thread{[this]() { impl_->fetchLoop(); }};
+}
+
+PrefetchSource::~PrefetchSource() {
+  {
+    std::lock_guard<std::mutex> lg{impl_->mutex};
+    impl_->stopping = true;
+  }
+  impl_->consumed.notify_all();
+  impl_->thread.join();
+}
+
+PrefetchStats PrefetchSource::stats() const {
+  PrefetchStats stats;
+  stats.bytesRead = impl_->bytesRead;
+  stats.bytesConsumed = impl_->bytesConsumed;
+  stats.stalls = impl_->stalls;
+  stats.stallTime = std::chrono::microseconds{impl_->stallTime.load()};
+  stats.readTime = std::chrono::microseconds{impl_->readTime.load()};
+  if (stats.readTime.count() > 0) {
+    stats.readThroughput = static_cast<double>(stats.bytesRead) * 1000000 /
+                           static_cast<double>(stats.readTime.count());
+  }
+  return stats;
+}
+
+int PrefetchSource::read(uint8_t* buf, int size) {
+  std::unique_lock<std::mutex> lock{impl_->mutex};
+  if (impl_->position >= impl_->file->size()) {
+    return AVERROR_EOF;
+  }
+  impl_->updateWindow();
+
+  if (!impl_->positionFetched() && !impl_->error) {
+    auto start = std::chrono::steady_clock::now();
+    impl_->fetched.wait(lock, [this] {
+      return impl_->positionFetched() || impl_->error;
+    });
+    impl_->stalls++;
+    impl_->stallTime += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  }
+  if (!impl_->positionFetched()) {
+    return impl_->error;
+  }
+
+  auto& block = impl_->blocks.front();
+  auto blockPosition = static_cast<size_t>(impl_->position - block.offset);
+  auto bytes =
+      std::min(static_cast<size_t>(size), block.data.size() - blockPosition);
+  std::memcpy(buf, block.data.data() + blockPosition, bytes);
+  impl_->position += static_cast<int64_t>(bytes);
+  impl_->bytesConsumed += bytes;
+  return static_cast<int>(bytes);
+}
+
+int64_t PrefetchSource::seek(int64_t offset, int whence) {
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  int64_t position{};
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return impl_->file->size();
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = impl_->position + offset;
+      break;
+    case SEEK_END:
+      position = impl_->file->size() + offset;
+      break;
+    default:
+      return AVERROR(EINVAL);
+  }
+  if (position < 0) {
+    return AVERROR(EINVAL);
+  }
+  impl_->position = position;
+  return position;
+}
+
+const std::string& PrefetchSource::name() const { return impl_->name; }
+
+}  // namespace ff_cpp
@@ -1,5 +1,8 @@
+#include <ff_cpp/ff_exception.h>
 #include <ff_cpp/ff_packet.h>
 
+#include <atomic>
+#include <limits>
 #include <ostream>
 
 namespace ff_cpp {
@@ -16,6 +19,60 @@ using UniqPacket = std::unique_ptr<AVPacket, decltype(avPacketDeleter)*>;
 
 struct Packet::Impl {
   UniqPacket packet{av_packet_alloc(), avPacketDeleter};
+  // owner pool while packet is taken from it, nullptr if packet allocated
+  // on heap, taken packet keeps pool alive so it may outlive PacketPool
+  std::shared_ptr<PacketPool::Impl> pool;
+  uint32_t slot{};
+};
+
+/**
+ * @brief Treiber stack over preallocated nodes. Head keeps index of top node
+ * (index + 1, 0 means empty) in low 32 bits and modification tag in high 32
+ * bits to avoid ABA problem
+ */
+struct PacketPool::Impl {
+  struct Node {
+    Packet::Impl packet;
+    std::atomic<uint32_t> next{};
+  };
+
+  size_t capacity{};
+  std::unique_ptr<Node[]> nodes;
+  std::atomic<uint64_t> head{};
+  std::atomic<size_t> available{};
+
+  static uint64_t makeHead(uint64_t oldHead, uint32_t index) {
+    return (((oldHead >> 32) + 1) << 32) | index;
+  }
+
+  Packet::Impl* acquire() {
+    auto top = head.load(std::memory_order_acquire);
+    while (true) {
+      auto index = static_cast<uint32_t>(top);
+      if (index == 0) {
+        return nullptr;
+      }
+      auto next = nodes[index - 1].next.load(std::memory_order_relaxed);
+      if (head.compare_exchange_weak(top, makeHead(top, next),
+                                     std::memory_order_acquire,
+                                     std::memory_order_acquire)) {
+        available.fetch_sub(1, std::memory_order_relaxed);
+        return &nodes[index - 1].packet;
+      }
+    }
+  }
+
+  void release(Packet::Impl* packet) {
+    av_packet_unref(packet->packet.get());
+    auto& node = nodes[packet->slot];
+    auto top = head.load(std::memory_order_relaxed);
+    do {
+      node.next.store(static_cast<uint32_t>(top), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(top, makeHead(top, packet->slot + 1),
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+    available.fetch_add(1, std::memory_order_relaxed);
+  }
 };
 
 Packet::Packet() {
@@ -23,7 +80,25 @@ Packet::Packet() {
   av_init_packet(impl_->packet.get());
 }
 
-Packet::~Packet() = default;
+Packet::Packet(PacketPool& pool) {
+  impl_.reset(pool.impl_->acquire());
+  if (impl_) {
+    impl_->pool = pool.impl_;
+  } else {
+    impl_ = std::make_unique<Impl>();
+    av_init_packet(impl_->packet.get());
+  }
+}
+
+Packet::Packet(Packet&& other) { impl_ = std::move(other.impl_); }
+
+Packet::~Packet() {
+  if (impl_ && impl_->pool) {
+    // pool is destroyed here if it was the last reference to it
+    auto pool = std::move(impl_->pool);
+    pool->release(impl_.release());
+  }
+}
 
 int64_t Packet::pts() const { return impl_->packet->pts; }
 
@@ -31,7 +106,44 @@ int64_t Packet::dts() const { return impl_->packet->dts; }
 
 int Packet::streamIndex() const { return impl_->packet->stream_index; }
 
-Packet::operator AVPacket*() { return impl_->packet.get(); }
+bool Packet::isKeyframe() const {
+  return impl_->packet->flags & AV_PKT_FLAG_KEY;
+}
+
+Packet::operator AVPacket*() {
+  // packet moved out of callback is read into again as heap packet
+  if (!impl_) {
+    impl_ = std::make_unique<Impl>();
+    av_init_packet(impl_->packet.get());
+  }
+  return impl_->packet.get();
+}
+
+PacketPool::PacketPool(size_t capacity) {
+  if (capacity >= std::numeric_limits<uint32_t>::max()) {
+    throw FFCppException("Packet pool capacity is too big");
+  }
+  impl_ = std::make_shared<Impl>();
+  impl_->capacity = capacity;
+  impl_->nodes.reset(new Impl::Node[capacity]);
+  for (size_t i = 0; i < capacity; i++) {
+    auto& packet = impl_->nodes[i].packet;
+    if (!packet.packet) {
+      throw FFCppException("Unable to alloc packet");
+    }
+    av_init_packet(packet.packet.get());
+    packet.slot = static_cast<uint32_t>(i);
+    impl_->release(&packet);
+  }
+}
+
+PacketPool::~PacketPool() = default;
+
+size_t PacketPool::capacity() const { return impl_->capacity; }
+
+size_t PacketPool::available() const {
+  return impl_->available.load(std::memory_order_relaxed);
+}
 
 std::ostream& operator<<(std::ostream& ost, const Packet& pkt) {
   ost << "Packet:\n";
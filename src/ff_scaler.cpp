@@ -69,6 +69,20 @@ ff_cpp::Frame Scaler::scale(ff_cpp::Frame& srcFrame, int dstAlignment) {
   return dstFrame;
 }
 
+ff_cpp::Frame Scaler::scale(ff_cpp::Frame& srcFrame, int dstAlignment,
+                            ff_cpp::FramePool& pool) {
+  if (srcFrame.width() != impl_->srcWidth ||
+      srcFrame.height() != impl_->srcHeight ||
+      srcFrame.format() != impl_->srcFormat) {
+    throw ff_cpp::FFCppException{"Unexpected src frame parameters"};
+  }
+
+  ff_cpp::Frame dstFrame{pool, impl_->dstWidth, impl_->dstHeight,
+                         impl_->dstFormat, dstAlignment};
+  scale(srcFrame, dstFrame);
+  return dstFrame;
+}
+
 ff_cpp::Frame& Scaler::scale(ff_cpp::Frame& srcFrame, ff_cpp::Frame& dstFrame) {
   if (srcFrame.width() != impl_->srcWidth ||
       srcFrame.height() != impl_->srcHeight ||
@@ -0,0 +1,64 @@
+#include <ff_cpp/ff_exception.h>
+#include <ff_cpp/ff_status.h>
+
+namespace ff_cpp {
+
+Status Status::fromError(int error) noexcept {
+  if (error >= EXIT_SUCCESS) {
+    return Status{};
+  }
+  if (error == AVERROR(ETIMEDOUT)) {
+    return Status{StatusCode::TimeoutElapsed, error,
+                  "Timeout elapsed while read frame"};
+  }
+  if (error == AVERROR_EXIT) {
+    return Status{StatusCode::Interrupted, error, "Demuxer stopped"};
+  }
+  if (error == AVERROR_EOF) {
+    return Status{StatusCode::EndOfFile, error, "End of file reached"};
+  }
+  if (error == AVERROR(EAGAIN)) {
+    return Status{StatusCode::TryAgain, error};
+  }
+  return Status{StatusCode::ProcessingError, error};
+}
+
+std::string Status::message() const {
+  if (!what_) {
+    return error_ ? av_make_error_string(error_) : std::string{};
+  }
+  std::string msg{what_};
+  if (error_) {
+    msg += ", reason: " + av_make_error_string(error_);
+  }
+  return msg;
+}
+
+void Status::throwIfError() const {
+  switch (code_) {
+    case StatusCode::Ok:
+      return;
+    case StatusCode::Error:
+      throw FFCppException(message());
+    case StatusCode::TimeoutElapsed:
+      throw TimeoutElapsed(message());
+    case StatusCode::BadInput:
+      throw BadInput(message(), "");
+    case StatusCode::OptionsNotAccepted:
+      throw OptionsNotAccepted(message(), {});
+    case StatusCode::NoStream:
+      throw NoStream(message());
+    case StatusCode::EndOfFile:
+      throw EndOfFile(message());
+    case StatusCode::FilterError:
+      throw FilterError(message());
+    case StatusCode::Interrupted:
+      throw Interrupted(message());
+    case StatusCode::ProcessingError:
+    case StatusCode::TryAgain:
+      break;
+  }
+  throw ProcessingError(message());
+}
+
+}  // namespace ff_cpp
@@ -0,0 +1,289 @@
+#include <ff_cpp/ff_exception.h>
+#include <ff_cpp/ff_stream_info_cache.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace ff_cpp {
+
+namespace {
+
+constexpr char STREAM_INFO_CACHE_HEADER[] = "ff_cpp stream info cache 1";
+
+void avCodecParametersDeleter(AVCodecParameters* par) {
+  if (par) {
+    avcodec_parameters_free(&par);
+  }
+}
+using UniqCodecParameters =
+    std::unique_ptr<AVCodecParameters, decltype(avCodecParametersDeleter)*>;
+
+UniqCodecParameters allocParameters() {
+  UniqCodecParameters par{avcodec_parameters_alloc(),
+                          avCodecParametersDeleter};
+  if (!par) {
+    throw FFCppException(av_make_error_string(AVERROR(ENOMEM)));
+  }
+  return par;
+}
+
+struct CachedStream {
+  int id{};
+  AVRational timeBase{};
+  AVRational averageFps{};
+  AVRational realFps{};
+  UniqCodecParameters codecpar{nullptr, avCodecParametersDeleter};
+};
+
+using CachedInput = std::vector<CachedStream>;
+
+std::ostream& operator<<(std::ostream& ost, const AVRational& r) {
+  return ost << r.num << " " << r.den;
+}
+
+std::istream& operator>>(std::istream& ist, AVRational& r) {
+  return ist >> r.num >> r.den;
+}
+
+/**
+ * @brief Codec parameters as one line of text, extradata is hex encoded
+ */
+void writeParameters(std::ostream& ost, const AVCodecParameters& par) {
+  ost << par.codec_type << " " << par.codec_id << " " << par.codec_tag << " "
+      << par.format << " " << par.bit_rate << " " << par.bits_per_coded_sample
+      << " " << par.bits_per_raw_sample << " " << par.profile << " "
+      << par.level << " " << par.width << " " << par.height << " "
+      << par.sample_aspect_ratio << " " << par.field_order << " "
+      << par.color_range << " " << par.color_primaries << " "
+      << par.color_trc << " " << par.color_space << " "
+      << par.chroma_location << " " << par.video_delay << " "
+      << par.channel_layout << " " << par.channels << " " << par.sample_rate
+      << " " << par.block_align << " " << par.frame_size << " "
+      << par.initial_padding << " " << par.trailing_padding << " "
+      << par.seek_preroll << " " << par.extradata_size;
+  if (par.extradata_size > 0) {
+    ost << " " << std::hex << std::setfill('0');
+    for (int i = 0; i < par.extradata_size; i++) {
+      ost << std::setw(2) << static_cast<int>(par.extradata[i]);
+    }
+    ost << std::dec;
+  }
+}
+
+/**
+ * @brief Codec parameters written by writeParameters()
+ *
+ * @return false if text is malformed
+ */
+bool readParameters(std::istream& ist, AVCodecParameters& par) {
+  int codecType{};
+  int codecId{};
+  int fieldOrder{};
+  int colorRange{};
+  int colorPrimaries{};
+  int colorTrc{};
+  int colorSpace{};
+  int chromaLocation{};
+  int extradataSize{};
+  ist >> codecType >> codecId >> par.codec_tag >> par.format >> par.bit_rate >>
+      par.bits_per_coded_sample >> par.bits_per_raw_sample >> par.profile >>
+      par.level >> par.width >> par.height >> par.sample_aspect_ratio >>
+      fieldOrder >> colorRange >> colorPrimaries >> colorTrc >> colorSpace >>
+      chromaLocation >> par.video_delay >> par.channel_layout >>
+      par.channels >> par.sample_rate >> par.block_align >> par.frame_size >>
+      par.initial_padding >> par.trailing_padding >> par.seek_preroll >>
+      extradataSize;
+  if (!ist || extradataSize < 0) {
+    return false;
+  }
+  par.codec_type = static_cast<AVMediaType>(codecType);
+  par.codec_id = static_cast<AVCodecID>(codecId);
+  par.field_order = static_cast<decltype(par.field_order)>(fieldOrder);
+  par.color_range = static_cast<decltype(par.color_range)>(colorRange);
+  par.color_primaries =
+      static_cast<decltype(par.color_primaries)>(colorPrimaries);
+  par.color_trc = static_cast<decltype(par.color_trc)>(colorTrc);
+  par.color_space = static_cast<decltype(par.color_space)>(colorSpace);
+  par.chroma_location =
+      static_cast<decltype(par.chroma_location)>(chromaLocation);
+
+  if (extradataSize > 0) {
+    std::string hex;
+    ist >> hex;
+    if (!ist || hex.size() != static_cast<size_t>(extradataSize) * 2 ||
+        !std::all_of(hex.begin(), hex.end(), [](unsigned char c) {
+          return std::isxdigit(c) != 0;
+        })) {
+      return false;
+    }
+    par.extradata = static_cast<uint8_t*>(
+        av_mallocz(extradataSize + AV_INPUT_BUFFER_PADDING_SIZE));
+    if (!par.extradata) {
+      throw FFCppException(av_make_error_string(AVERROR(ENOMEM)));
+    }
+    par.extradata_size = extradataSize;
+    for (int i = 0; i < extradataSize; i++) {
+      par.extradata[i] =
+          static_cast<uint8_t>(std::stoi(hex.substr(i * 2, 2), nullptr, 16));
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+struct StreamInfoCache::Impl {
+  mutable std::mutex mutex;
+  std::map<std::string, CachedInput> inputs;
+};
+
+StreamInfoCache::StreamInfoCache() { impl_ = std::make_unique<Impl>(); }
+
+StreamInfoCache::~StreamInfoCache() {}
+
+bool StreamInfoCache::contains(const std::string& input) const {
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  return impl_->inputs.count(input) > 0;
+}
+
+void StreamInfoCache::erase(const std::string& input) {
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  impl_->inputs.erase(input);
+}
+
+void StreamInfoCache::clear() {
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  impl_->inputs.clear();
+}
+
+size_t StreamInfoCache::size() const {
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  return impl_->inputs.size();
+}
+
+void StreamInfoCache::save(const std::string& path) const {
+  std::ofstream file{path, std::ofstream::trunc};
+  file << STREAM_INFO_CACHE_HEADER << "\n";
+  {
+    std::lock_guard<std::mutex> lg{impl_->mutex};
+    for (const auto& input : impl_->inputs) {
+      file << std::quoted(input.first) << " " << input.second.size() << "\n";
+      for (const auto& stream : input.second) {
+        file << stream.id << " " << stream.timeBase << " "
+             << stream.averageFps << " " << stream.realFps << " ";
+        writeParameters(file, *stream.codecpar);
+        file << "\n";
+      }
+    }
+  }
+  if (!file) {
+    throw FFCppException("Unable to write stream info cache to " + path);
+  }
+}
+
+void StreamInfoCache::load(const std::string& path) {
+  std::ifstream file{path};
+  std::string header;
+  if (!std::getline(file, header)) {
+    throw BadInput("Unable to read stream info cache", path);
+  }
+  if (header != STREAM_INFO_CACHE_HEADER) {
+    throw BadInput("Not a stream info cache", path);
+  }
+
+  std::map<std::string, CachedInput> inputs;
+  std::string input;
+  size_t streams{};
+  while (file >> std::quoted(input) >> streams) {
+    CachedInput cached;
+    for (size_t i = 0; i < streams; i++) {
+      CachedStream stream;
+      stream.codecpar = allocParameters();
+      file >> stream.id >> stream.timeBase >> stream.averageFps >>
+          stream.realFps;
+      if (!file || !readParameters(file, *stream.codecpar)) {
+        throw BadInput("Malformed stream info cache", path);
+      }
+      cached.push_back(std::move(stream));
+    }
+    inputs[input] = std::move(cached);
+  }
+  if (!file.eof()) {
+    throw BadInput("Malformed stream info cache", path);
+  }
+
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  for (auto& cached : inputs) {
+    impl_->inputs[cached.first] = std::move(cached.second);
+  }
+}
+
+void StreamInfoCache::store(const std::string& input,
+                            const AVFormatContext* context) {
+  CachedInput cached;
+  for (unsigned int i = 0; i < context->nb_streams; i++) {
+    const auto stream = context->streams[i];
+    CachedStream cachedStream;
+    cachedStream.id = stream->id;
+    cachedStream.timeBase = stream->time_base;
+    cachedStream.averageFps = stream->avg_frame_rate;
+    cachedStream.realFps = stream->r_frame_rate;
+    cachedStream.codecpar = allocParameters();
+    if (auto err = avcodec_parameters_copy(cachedStream.codecpar.get(),
+                                           stream->codecpar);
+        err < EXIT_SUCCESS) {
+      throw FFCppException(av_err2str(err));
+    }
+    cached.push_back(std::move(cachedStream));
+  }
+
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  impl_->inputs[input] = std::move(cached);
+}
+
+bool StreamInfoCache::apply(const std::string& input,
+                            AVFormatContext* context) const {
+  std::lock_guard<std::mutex> lg{impl_->mutex};
+  auto cached = impl_->inputs.find(input);
+  if (cached == impl_->inputs.end() ||
+      cached->second.size() != context->nb_streams) {
+    return false;
+  }
+  // streams opened by demuxer must be the same as cached ones, codec could be
+  // unknown until probing
+  for (unsigned int i = 0; i < context->nb_streams; i++) {
+    const auto stream = context->streams[i];
+    const auto& cachedStream = cached->second[i];
+    if (stream->id != cachedStream.id ||
+        (stream->codecpar->codec_type != AVMEDIA_TYPE_UNKNOWN &&
+         stream->codecpar->codec_type != cachedStream.codecpar->codec_type) ||
+        (stream->codecpar->codec_id != AV_CODEC_ID_NONE &&
+         stream->codecpar->codec_id != cachedStream.codecpar->codec_id)) {
+      return false;
+    }
+  }
+
+  for (unsigned int i = 0; i < context->nb_streams; i++) {
+    const auto stream = context->streams[i];
+    const auto& cachedStream = cached->second[i];
+    if (auto err = avcodec_parameters_copy(stream->codecpar,
+                                           cachedStream.codecpar.get());
+        err < EXIT_SUCCESS) {
+      throw FFCppException(av_err2str(err));
+    }
+    if (!stream->avg_frame_rate.num) {
+      stream->avg_frame_rate = cachedStream.averageFps;
+    }
+    if (!stream->r_frame_rate.num) {
+      stream->r_frame_rate = cachedStream.realFps;
+    }
+  }
+  return true;
+}
+
+}  // namespace ff_cpp
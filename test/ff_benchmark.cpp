@@ -0,0 +1,302 @@
+#include <ff_cpp/ff_batch_decoder.h>
+#include <ff_cpp/ff_demuxer.h>
+#include <ff_cpp/ff_exception.h>
+#include <ff_cpp/ff_queue.h>
+
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Benchmarks are hidden, run them with: demuxer_tst [benchmark]
+
+namespace {
+
+std::vector<uint8_t> readAsset(const std::string& path) {
+  std::ifstream f(path, std::ifstream::binary);
+  return std::vector<uint8_t>{std::istreambuf_iterator<char>(f),
+                              std::istreambuf_iterator<char>()};
+}
+
+/**
+ * @brief Mutex and condition variable queue as integrations usually write
+ * it, baseline for lock-free queues
+ */
+template <typename T>
+class MutexQueue {
+ public:
+  explicit MutexQueue(size_t capacity) : capacity_(capacity) {}
+
+  bool push(T&& item, ff_cpp::QueueWait) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    notFull_.wait(lock,
+                  [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    notEmpty_.notify_one();
+    return true;
+  }
+
+  std::optional<T> pop(ff_cpp::QueueWait) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return std::nullopt;
+    }
+    std::optional<T> item{std::move(items_.front())};
+    items_.pop_front();
+    notFull_.notify_one();
+    return item;
+  }
+
+  void close() {
+    std::lock_guard<std::mutex> lg{mutex_};
+    closed_ = true;
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  bool closed_{};
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+};
+
+/**
+ * @brief Circulate pooled packets: producers take free packet from one queue
+ * and pass it to consumers through other queue, consumers give it back. Only
+ * handles move, so queues dominate the cost
+ *
+ * @return number of packets received by consumers
+ */
+template <typename Queue>
+int relayPackets(int producers, int consumers, ff_cpp::QueueWait wait) {
+  constexpr int packets = 100000;
+  constexpr size_t handles = 64;
+  ff_cpp::PacketPool pool{handles};
+  Queue free{handles};
+  Queue full{handles};
+  for (size_t i = 0; i < handles; i++) {
+    free.push(ff_cpp::Packet{pool}, wait);
+  }
+
+  std::atomic<int> received{};
+  std::vector<std::thread> consumerThreads;
+  for (int i = 0; i < consumers; i++) {
+    consumerThreads.emplace_back([&free, &full, &received, wait]() {
+      while (auto packet = full.pop(wait)) {
+        received++;
+        free.push(std::move(*packet), wait);
+      }
+    });
+  }
+  std::vector<std::thread> producerThreads;
+  for (int i = 0; i < producers; i++) {
+    producerThreads.emplace_back([&free, &full, producers, wait]() {
+      for (int p = 0; p < packets / producers; p++) {
+        full.push(std::move(*free.pop(wait)), wait);
+      }
+    });
+  }
+  for (auto& thread : producerThreads) {
+    thread.join();
+  }
+  full.close();
+  for (auto& thread : consumerThreads) {
+    thread.join();
+  }
+  return received;
+}
+
+}  // namespace
+
+TEST_CASE("Start callbacks dispatch", "[.][benchmark]") {
+  const auto data = readAsset("small_bunny_1080p_60fps.mp4");
+  REQUIRE(!data.empty());
+
+  // only packet path is measured, decoding would hide dispatch cost
+  auto demuxAll = [&data](auto&& start) {
+    ff_cpp::Demuxer demuxer(data.data(), data.size());
+    demuxer.prepare();
+    const auto videoIndex = static_cast<int>(demuxer.bestVideoStream().index());
+    int videoPackets{};
+    try {
+      start(demuxer, videoIndex, videoPackets);
+    } catch (const ff_cpp::EndOfFile&) {
+    }
+    return videoPackets;
+  };
+
+  BENCHMARK("std::function callbacks") {
+    return demuxAll([](ff_cpp::Demuxer& demuxer, int videoIndex,
+                       int& videoPackets) {
+      demuxer.start(ff_cpp::frame_callback{[](ff_cpp::Frame&) {}},
+                    ff_cpp::packet_callback{
+                        [videoIndex, &videoPackets](ff_cpp::Packet& pkt) {
+                          videoPackets += pkt.streamIndex() == videoIndex;
+                          return false;
+                        }});
+    });
+  };
+
+  BENCHMARK("Inlined callbacks") {
+    return demuxAll([](ff_cpp::Demuxer& demuxer, int videoIndex,
+                       int& videoPackets) {
+      demuxer.start([](ff_cpp::Frame&) {},
+                    [videoIndex, &videoPackets](ff_cpp::Packet& pkt) {
+                      videoPackets += pkt.streamIndex() == videoIndex;
+                      return false;
+                    });
+    });
+  };
+}
+
+TEST_CASE("Aggregate decoding fps of many streams", "[.][benchmark]") {
+  const auto data = readAsset("small_bunny_1080p_60fps.mp4");
+  REQUIRE(!data.empty());
+  constexpr int framesPerStream = 30;
+  const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+  // every stream decodes the same frames on its own thread, aggregate fps is
+  // total number of decoded frames per second of wall time
+  auto aggregateFps = [&data](unsigned int streams,
+                              const ff_cpp::DecoderOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < streams; i++) {
+      threads.emplace_back([&data, &options]() {
+        ff_cpp::Demuxer demuxer(data.data(), data.size());
+        demuxer.prepare();
+        demuxer.createDecoder(demuxer.bestVideoStream().index(),
+                              AV_CODEC_ID_NONE, options);
+        int frames{};
+        for (auto& frame : demuxer.frames()) {
+          (void)frame;
+          if (++frames == framesPerStream) {
+            break;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return streams * framesPerStream / elapsed.count();
+  };
+
+  const auto budget = ff_cpp::decodeThreadBudget();
+  ff_cpp::DecoderOptions shared;
+  shared.shareThreadBudget = true;
+  for (unsigned int streams : {50u, 100u, 200u}) {
+    WARN(streams << " streams, default options: " << aggregateFps(streams, {})
+                 << " fps");
+    ff_cpp::setDecodeThreadBudget({0, 1});
+    WARN(streams << " streams, shared budget of " << cores
+                 << " threads, default expected decoders: "
+                 << aggregateFps(streams, shared) << " fps");
+    ff_cpp::setDecodeThreadBudget({0, streams});
+    WARN(streams << " streams, shared budget of " << cores << " threads, "
+                 << streams << " expected decoders: "
+                 << aggregateFps(streams, shared) << " fps");
+    WARN(streams << " streams, " << cores << " threads per decoder: "
+                 << aggregateFps(streams, {static_cast<int>(cores)})
+                 << " fps");
+  }
+  ff_cpp::setDecodeThreadBudget(budget);
+}
+
+TEST_CASE("Decode speed profiles", "[.][benchmark]") {
+  const auto data = readAsset("small_bunny_1080p_60fps.mp4");
+  REQUIRE(!data.empty());
+
+  // cpu time is summed over all threads of the process, so it shows cost of
+  // decoding while fps shows latency of single stream
+  auto decode = [&data](ff_cpp::DecodeSpeed speed, const char* name) {
+    ff_cpp::DecoderOptions options;
+    options.speed = speed;
+    auto start = std::chrono::steady_clock::now();
+    auto cpuStart = std::clock();
+
+    ff_cpp::Demuxer demuxer(data.data(), data.size());
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index(), AV_CODEC_ID_NONE,
+                          options);
+    int frames{};
+    for (auto& frame : demuxer.frames()) {
+      (void)frame;
+      frames++;
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    auto cpuTime =
+        static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    WARN(name << ": " << frames / elapsed.count() << " fps, "
+              << cpuTime * 1000 / frames << " ms of cpu time per frame");
+  };
+
+  decode(ff_cpp::DecodeSpeed::Exact, "Exact");
+  decode(ff_cpp::DecodeSpeed::Fast, "Fast");
+  decode(ff_cpp::DecodeSpeed::Fastest, "Fastest");
+}
+
+TEST_CASE("GOP-parallel batch decoding", "[.][benchmark]") {
+  const std::string path{"small_bunny_1080p_60fps.mp4"};
+  const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (unsigned int threads = 1; threads <= cores; threads *= 2) {
+    for (auto ordered : {true, false}) {
+      ff_cpp::BatchOptions options;
+      options.threads = threads;
+      options.ordered = ordered;
+      ff_cpp::BatchDecoder decoder(path);
+      int frames{};
+      auto start = std::chrono::steady_clock::now();
+      decoder.decode([&frames](ff_cpp::Frame&) { frames++; }, options);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      WARN(threads << " threads, " << (ordered ? "ordered" : "unordered")
+                   << ": " << frames / elapsed.count() << " fps");
+    }
+  }
+}
+
+TEST_CASE("Queues of packet handles", "[.][benchmark]") {
+  using ff_cpp::Packet;
+  using ff_cpp::QueueWait;
+
+  BENCHMARK("Mutex queue 1:1") {
+    return relayPackets<MutexQueue<Packet>>(1, 1, QueueWait::Block);
+  };
+  BENCHMARK("SpscQueue 1:1 blocking") {
+    return relayPackets<ff_cpp::PacketSpscQueue>(1, 1, QueueWait::Block);
+  };
+  BENCHMARK("SpscQueue 1:1 spinning") {
+    return relayPackets<ff_cpp::PacketSpscQueue>(1, 1, QueueWait::Spin);
+  };
+  BENCHMARK("Mutex queue 2:2") {
+    return relayPackets<MutexQueue<Packet>>(2, 2, QueueWait::Block);
+  };
+  BENCHMARK("MpmcQueue 2:2 blocking") {
+    return relayPackets<ff_cpp::PacketMpmcQueue>(2, 2, QueueWait::Block);
+  };
+  BENCHMARK("MpmcQueue 2:2 spinning") {
+    return relayPackets<ff_cpp::PacketMpmcQueue>(2, 2, QueueWait::Spin);
+  };
+}
@@ -1,20 +1,381 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do \
                           // this in one cpp file
+#include <ff_cpp/ff_batch_decoder.h>
 #include <ff_cpp/ff_demuxer.h>
+#include <ff_cpp/ff_demuxer_pool.h>
 #include <ff_cpp/ff_exception.h>
 #include <ff_cpp/ff_filter.h>
 #include <ff_cpp/ff_frame.h>
+#include <ff_cpp/ff_frame_cache.h>
 #include <ff_cpp/ff_packet.h>
+#include <ff_cpp/ff_queue.h>
 #include <ff_cpp/ff_scaler.h>
 
 #include <algorithm>
+#include <atomic>
 #include <catch2/catch.hpp>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iterator>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 const std::string url("file:small_bunny_1080p_60fps.mp4");
 const std::string emptyFileUrl("file:empty_file.mp4");
 
+namespace {
+
+/**
+ * @brief Path of file in temporary directory, the file is removed with the
+ * object
+ */
+class TempFile {
+ public:
+  explicit TempFile(const std::string &name) {
+    std::string directory{"/tmp"};
+    for (auto variable : {"TMPDIR", "TEMP", "TMP"}) {
+      if (auto value = std::getenv(variable)) {
+        directory = value;
+        break;
+      }
+    }
+    // test cases could run in parallel processes
+    path_ = directory + "/ff_cpp_" + std::to_string(std::random_device{}()) +
+            "_" + name;
+  }
+  ~TempFile() { std::remove(path_.c_str()); }
+  TempFile(const TempFile &) = delete;
+  TempFile &operator=(const TempFile &) = delete;
+
+  const std::string &path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
+/**
+ * @brief Synthetic mpeg4 clip with a keyframe every gopSize frames. It is
+ * encoded at test time, so tests of GOP handling don't depend on GOP
+ * structure of bundled assets. GOPs with B-frames are closed, but keyframes
+ * are decoded before frames displayed right before them
+ */
+class TestClip {
+ public:
+  static constexpr int width = 320;
+  static constexpr int height = 240;
+  static constexpr int fps = 25;
+
+  TestClip(int frames, int gopSize, int bFrames = 0,
+           const std::string &extension = "mp4")
+      : file_("clip." + extension), frames_(frames), gopSize_(gopSize) {
+    AVFormatContext *output{};
+    REQUIRE(avformat_alloc_output_context2(&output, nullptr, nullptr,
+                                           file_.path().c_str()) >= 0);
+    std::unique_ptr<AVFormatContext, void (*)(AVFormatContext *)>
+        outputGuard{output, [](AVFormatContext *ctxt) {
+                      avio_closep(&ctxt->pb);
+                      avformat_free_context(ctxt);
+                    }};
+    auto codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    REQUIRE(codec);
+    auto encoder = avcodec_alloc_context3(codec);
+    REQUIRE(encoder);
+    std::unique_ptr<AVCodecContext, void (*)(AVCodecContext *)> encoderGuard{
+        encoder, [](AVCodecContext *ctxt) { avcodec_free_context(&ctxt); }};
+    encoder->width = width;
+    encoder->height = height;
+    encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+    encoder->time_base = AVRational{1, fps};
+    encoder->framerate = AVRational{fps, 1};
+    encoder->gop_size = gopSize;
+    encoder->max_b_frames = bFrames;
+    if (bFrames > 0) {
+      encoder->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+    }
+    if (output->oformat->flags & AVFMT_GLOBALHEADER) {
+      encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    // scene change detection must not insert keyframes
+    AVDictionary *options{};
+    av_dict_set(&options, "sc_threshold", "1000000000", 0);
+    auto err = avcodec_open2(encoder, codec, &options);
+    av_dict_free(&options);
+    REQUIRE(err == 0);
+
+    auto stream = avformat_new_stream(output, nullptr);
+    REQUIRE(stream);
+    stream->time_base = encoder->time_base;
+    stream->avg_frame_rate = encoder->framerate;
+    REQUIRE(avcodec_parameters_from_context(stream->codecpar, encoder) >= 0);
+    REQUIRE(avio_open(&output->pb, file_.path().c_str(), AVIO_FLAG_WRITE) >=
+            0);
+    REQUIRE(avformat_write_header(output, nullptr) >= 0);
+
+    auto packet = av_packet_alloc();
+    std::unique_ptr<AVPacket *, void (*)(AVPacket **)> packetGuard{
+        &packet, av_packet_free};
+    auto encode = [&](AVFrame *frame) {
+      REQUIRE(avcodec_send_frame(encoder, frame) == 0);
+      while (avcodec_receive_packet(encoder, packet) == 0) {
+        av_packet_rescale_ts(packet, encoder->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        REQUIRE(av_interleaved_write_frame(output, packet) == 0);
+      }
+    };
+    for (int i = 0; i < frames; i++) {
+      auto frame = av_frame_alloc();
+      std::unique_ptr<AVFrame *, void (*)(AVFrame **)> frameGuard{
+          &frame, av_frame_free};
+      frame->width = width;
+      frame->height = height;
+      frame->format = AV_PIX_FMT_YUV420P;
+      frame->pts = i;
+      REQUIRE(av_frame_get_buffer(frame, 0) == 0);
+      // moving gradient, every frame differs from previous one
+      for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+          frame->data[0][y * frame->linesize[0] + x] =
+              static_cast<uint8_t>(x + 2 * y + 4 * i);
+        }
+      }
+      for (int plane = 1; plane < 3; plane++) {
+        for (int y = 0; y < height / 2; y++) {
+          std::fill_n(frame->data[plane] + y * frame->linesize[plane],
+                      width / 2, uint8_t{128});
+        }
+      }
+      encode(frame);
+    }
+    encode(nullptr);
+    REQUIRE(av_write_trailer(output) == 0);
+  }
+
+  const std::string &path() const { return file_.path(); }
+  std::string url() const { return "file:" + file_.path(); }
+  int frames() const { return frames_; }
+  /**
+   * @brief number of GOPs, encoder could start GOP earlier if clip has
+   * B-frames, so it is exact only for clips without them
+   */
+  int gops() const { return (frames_ + gopSize_ - 1) / gopSize_; }
+  /**
+   * @brief memory used by image of one decoded frame
+   */
+  static size_t frameBytes() { return width * height * 3 / 2; }
+
+ private:
+  TempFile file_;
+  int frames_{};
+  int gopSize_{};
+};
+
+/**
+ * @brief One-shot gate, wait() blocks until open() called, so tests order
+ * threads without sleeps
+ */
+class Latch {
+ public:
+  void open() {
+    std::lock_guard<std::mutex> lg{mutex_};
+    open_ = true;
+    opened_.notify_all();
+  }
+  /**
+   * @return false if latch was not opened within timeout
+   */
+  bool wait(std::chrono::milliseconds timeout = std::chrono::seconds{10}) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    return opened_.wait_for(lock, timeout, [this]() { return open_; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable opened_;
+  bool open_{};
+};
+
+/**
+ * @brief Live input source fed by test, read() waits for data, available()
+ * reports buffered bytes until source is closed
+ */
+class LiveSource : public ff_cpp::IOSource {
+ public:
+  void push(const std::string &data) {
+    std::lock_guard<std::mutex> lg{mutex_};
+    buffer_.insert(buffer_.end(), data.begin(), data.end());
+    changed_.notify_all();
+  }
+  void close() {
+    std::lock_guard<std::mutex> lg{mutex_};
+    closed_ = true;
+    changed_.notify_all();
+  }
+
+  int read(uint8_t *buf, int size) override {
+    std::unique_lock<std::mutex> lock{mutex_};
+    changed_.wait(lock, [this]() { return !buffer_.empty() || closed_; });
+    if (buffer_.empty()) {
+      return AVERROR_EOF;
+    }
+    auto bytes = std::min(buffer_.size(), static_cast<size_t>(size));
+    std::copy_n(buffer_.begin(), bytes, buf);
+    buffer_.erase(buffer_.begin(), buffer_.begin() + bytes);
+    return static_cast<int>(bytes);
+  }
+  int64_t seek(int64_t, int) override { return AVERROR(ENOSYS); }
+  const std::string &name() const override { return name_; }
+  int64_t available() const noexcept override {
+    std::lock_guard<std::mutex> lg{mutex_};
+    return closed_ ? -1 : static_cast<int64_t>(buffer_.size());
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<uint8_t> buffer_;
+  bool closed_{};
+  std::string name_{"live"};
+};
+
+/**
+ * @brief Content of file
+ */
+std::string readFile(const std::string &path) {
+  std::ifstream ist{path, std::ifstream::binary};
+  return {std::istreambuf_iterator<char>{ist},
+          std::istreambuf_iterator<char>{}};
+}
+
+/**
+ * @brief TCP server on free local port. It accepts one client, sends it data
+ * and keeps connection open without sending anything more, so reads of the
+ * client stall until server is destroyed
+ */
+class StalledServer {
+ public:
+#ifdef _WIN32
+  using Socket = SOCKET;
+  static constexpr Socket invalidSocket = INVALID_SOCKET;
+  static void closeSocket(Socket s) { closesocket(s); }
+#else
+  using Socket = int;
+  static constexpr Socket invalidSocket = -1;
+  static void closeSocket(Socket s) { close(s); }
+#endif
+#ifdef MSG_NOSIGNAL
+  // client which disconnected must not kill test process by SIGPIPE
+  static constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+  static constexpr int sendFlags = 0;
+#endif
+
+  explicit StalledServer(std::string data = {}) : data_(std::move(data)) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    REQUIRE(WSAStartup(MAKEWORD(2, 2), &wsaData) == 0);
+#endif
+    listener_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    REQUIRE(listener_ != invalidSocket);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // port 0 binds free port, so parallel test runs don't collide
+    address.sin_port = 0;
+    REQUIRE(bind(listener_, reinterpret_cast<sockaddr *>(&address),
+                 sizeof(address)) == 0);
+    socklen_t length = sizeof(address);
+    REQUIRE(getsockname(listener_, reinterpret_cast<sockaddr *>(&address),
+                        &length) == 0);
+    port_ = ntohs(address.sin_port);
+    REQUIRE(listen(listener_, 1) == 0);
+    stalledFuture_ = stalled_.get_future();
+    thread_ = std::thread{&StalledServer::serve, this};
+  }
+  ~StalledServer() {
+    done_ = true;
+    thread_.join();
+    closeSocket(listener_);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+  }
+  StalledServer(const StalledServer &) = delete;
+  StalledServer &operator=(const StalledServer &) = delete;
+
+  std::string url() const {
+    return "tcp://127.0.0.1:" + std::to_string(port_);
+  }
+  /**
+   * @brief Wait until client connected and all data is sent to it
+   *
+   * @return false if client didn't connect within timeout
+   */
+  bool waitStalled(std::chrono::seconds timeout = std::chrono::seconds{10}) {
+    return stalledFuture_.wait_for(timeout) == std::future_status::ready;
+  }
+
+ private:
+  void serve() {
+    auto client = invalidSocket;
+    while (!done_ && client == invalidSocket) {
+      fd_set readable;
+      FD_ZERO(&readable);
+      FD_SET(listener_, &readable);
+      timeval wait{0, 10000};
+      if (select(static_cast<int>(listener_ + 1), &readable, nullptr, nullptr,
+                 &wait) > 0) {
+        client = accept(listener_, nullptr, nullptr);
+      }
+    }
+    if (client == invalidSocket) {
+      return;
+    }
+    size_t sent{};
+    while (!done_ && sent < data_.size()) {
+      auto bytes = send(client, data_.data() + sent,
+                        static_cast<int>(data_.size() - sent), sendFlags);
+      if (bytes <= 0) {
+        break;
+      }
+      sent += static_cast<size_t>(bytes);
+    }
+    stalled_.set_value();
+    while (!done_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    closeSocket(client);
+  }
+
+  std::string data_;
+  Socket listener_{invalidSocket};
+  uint16_t port_{};
+  std::atomic<bool> done_{};
+  std::promise<void> stalled_;
+  std::future<void> stalledFuture_;
+  std::thread thread_;
+};
+
+}  // namespace
+
 TEST_CASE("Prepare demuxer", "[demuxer]") {
   SECTION("Empty url and empty parameters") {
     ff_cpp::Demuxer demuxer("");
@@ -38,6 +399,28 @@ TEST_CASE("Prepare demuxer", "[demuxer]") {
     REQUIRE_NOTHROW(demuxer.prepare());
     std::cout << demuxer << std::endl;
   }
+  SECTION("Prepare again drops decoders of previous input") {
+    TestClip clip(20, 10);
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    demuxer.prepare();
+    REQUIRE(demuxer.decoders().empty());
+    // input without decoders is demuxed to the end
+    int framesCount{};
+    REQUIRE_THROWS_AS(
+        demuxer.start([&framesCount](ff_cpp::Frame &) { framesCount++; }),
+        ff_cpp::EndOfFile);
+    REQUIRE(framesCount == 0);
+
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    for (auto &frame : demuxer.frames()) {
+      REQUIRE(frame.width() == TestClip::width);
+      framesCount++;
+    }
+    REQUIRE(framesCount == clip.frames());
+  }
   SECTION("Timeout") {
     ff_cpp::Demuxer demuxer("rtsp://localhost:5555/Some/Stream/3");
     try {
@@ -51,6 +434,281 @@ TEST_CASE("Prepare demuxer", "[demuxer]") {
   }
 }
 
+TEST_CASE("Stream info cache", "[demuxer]") {
+  auto cache = std::make_shared<ff_cpp::StreamInfoCache>();
+  int width{};
+  AVCodecID codec{};
+  AVRational fps{};
+  {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.setStreamInfoCache(cache);
+    demuxer.prepare();
+    REQUIRE_FALSE(demuxer.prepareStats().streamInfoCached);
+    REQUIRE(demuxer.prepareStats().total >=
+            demuxer.prepareStats().findStreamInfo);
+    REQUIRE(cache->contains(url));
+    width = demuxer.bestVideoStream().width();
+    codec = demuxer.bestVideoStream().codec();
+    fps = demuxer.bestVideoStream().averageFPS();
+  }
+
+  auto checkCached = [&](ff_cpp::Demuxer &demuxer) {
+    REQUIRE(demuxer.prepareStats().streamInfoCached);
+    const auto &stream = demuxer.bestVideoStream();
+    REQUIRE(stream.width() == width);
+    REQUIRE(stream.codec() == codec);
+    REQUIRE(av_cmp_q(stream.averageFPS(), fps) == 0);
+    demuxer.createDecoder(stream.index());
+    size_t frames{};
+    for (auto &frame : demuxer.frames()) {
+      REQUIRE(frame.width() == width);
+      if (++frames == 10) {
+        break;
+      }
+    }
+    REQUIRE(frames == 10);
+  };
+
+  SECTION("Skip probing") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.setStreamInfoCache(cache);
+    demuxer.prepare();
+    REQUIRE(demuxer.prepareStats().findStreamInfo.count() == 0);
+    checkCached(demuxer);
+  }
+  SECTION("Minimal probing") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.setStreamInfoCache(cache, ff_cpp::StartupProbe::Minimal);
+    demuxer.prepare();
+    checkCached(demuxer);
+  }
+  SECTION("Save and load") {
+    TempFile file("stream_info_cache.txt");
+    cache->save(file.path());
+    auto loaded = std::make_shared<ff_cpp::StreamInfoCache>();
+    loaded->load(file.path());
+    REQUIRE(loaded->size() == 1);
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.setStreamInfoCache(loaded);
+    demuxer.prepare();
+    checkCached(demuxer);
+
+    {
+      std::ofstream ost{file.path(), std::ofstream::trunc};
+      ost << "ff_cpp stream info cache 1\n\"" << url << "\" 2\n0 1 2\n";
+    }
+    REQUIRE_THROWS_AS(loaded->load(file.path()), ff_cpp::BadInput);
+    REQUIRE(loaded->size() == 1);
+
+    {
+      // stream header, codec parameters and extradata which is not hex
+      std::ofstream ost{file.path(), std::ofstream::trunc};
+      ost << "ff_cpp stream info cache 1\n\"other\" 1\n0 1 25 25 1 25 1";
+      for (int i = 0; i < 28; i++) {
+        ost << " 0";
+      }
+      ost << " 2 0z1x\n";
+    }
+    REQUIRE_THROWS_AS(loaded->load(file.path()), ff_cpp::BadInput);
+    REQUIRE(loaded->size() == 1);
+  }
+  SECTION("Minimal probing of changed input probes it in full") {
+    // parameters of other input are cached for the clip
+    TestClip clip(10, 5);
+    TempFile file("stream_info_cache.txt");
+    cache->save(file.path());
+    std::string content;
+    {
+      std::ifstream ist{file.path()};
+      content.assign(std::istreambuf_iterator<char>{ist},
+                     std::istreambuf_iterator<char>{});
+    }
+    const auto key = "\"" + url + "\"";
+    REQUIRE(content.find(key) != std::string::npos);
+    content.replace(content.find(key), key.size(), "\"" + clip.url() + "\"");
+    {
+      std::ofstream ost{file.path(), std::ofstream::trunc};
+      ost << content;
+    }
+    auto changed = std::make_shared<ff_cpp::StreamInfoCache>();
+    changed->load(file.path());
+
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.setStreamInfoCache(changed, ff_cpp::StartupProbe::Minimal);
+    demuxer.prepare();
+    REQUIRE_FALSE(demuxer.prepareStats().streamInfoCached);
+    REQUIRE(demuxer.bestVideoStream().width() == TestClip::width);
+
+    // fully probed parameters replaced stale ones
+    ff_cpp::Demuxer cached(clip.url());
+    cached.setStreamInfoCache(changed);
+    cached.prepare();
+    REQUIRE(cached.prepareStats().streamInfoCached);
+    const auto &stream = cached.bestVideoStream();
+    REQUIRE(stream.width() == TestClip::width);
+    REQUIRE(stream.codec() == AV_CODEC_ID_MPEG4);
+    REQUIRE(av_cmp_q(stream.averageFPS(), AVRational{TestClip::fps, 1}) == 0);
+  }
+  SECTION("Erase") {
+    cache->erase(url);
+    REQUIRE(cache->size() == 0);
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.setStreamInfoCache(cache);
+    demuxer.prepare();
+    REQUIRE_FALSE(demuxer.prepareStats().streamInfoCached);
+  }
+}
+
+TEST_CASE("Parallel prepare and stop", "[demuxer]") {
+  SECTION("Prepare async") {
+    ff_cpp::Demuxer demuxer(url);
+    auto prepared = demuxer.prepareAsync();
+    REQUIRE_NOTHROW(prepared.get());
+    REQUIRE(demuxer.bestVideoStream().width() == 1920);
+
+    ff_cpp::Demuxer invalid("invalid\\url");
+    auto failed = invalid.prepareAsync();
+    REQUIRE_THROWS_AS(failed.get(), ff_cpp::BadInput);
+  }
+  SECTION("Prepare all") {
+    std::vector<std::unique_ptr<ff_cpp::Demuxer>> owned;
+    std::vector<ff_cpp::Demuxer *> demuxers;
+    for (size_t i = 0; i < 8; i++) {
+      owned.push_back(
+          std::make_unique<ff_cpp::Demuxer>(i == 3 ? emptyFileUrl : url));
+      demuxers.push_back(owned.back().get());
+    }
+    auto results = ff_cpp::prepareAll(demuxers, 3);
+    REQUIRE(results.size() == demuxers.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      REQUIRE(results[i].demuxer == demuxers[i]);
+      if (i == 3) {
+        REQUIRE_FALSE(results[i].ok());
+        REQUIRE_THROWS_AS(std::rethrow_exception(results[i].error),
+                          ff_cpp::BadInput);
+      } else {
+        REQUIRE(results[i].ok());
+        REQUIRE(results[i].elapsed >= results[i].stats.total);
+        REQUIRE_FALSE(demuxers[i]->streams().empty());
+      }
+    }
+    REQUIRE(ff_cpp::prepareAll({}).empty());
+  }
+  SECTION("Stop stalled prepare") {
+    // peer accepted connection, but doesn't send anything
+    StalledServer server;
+    ff_cpp::Demuxer demuxer(server.url());
+    auto prepared = demuxer.prepareAsync({}, 30);
+    REQUIRE(server.waitStalled());
+    REQUIRE(prepared.wait_for(std::chrono::seconds{0}) ==
+            std::future_status::timeout);
+    auto stopTime = std::chrono::steady_clock::now();
+    demuxer.stop();
+    prepared.wait();
+    auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - stopTime);
+    WARN("Stop to return latency: " << latency.count() << " ms");
+    REQUIRE_THROWS_AS(prepared.get(), ff_cpp::Interrupted);
+    REQUIRE(latency < std::chrono::seconds{1});
+  }
+  SECTION("Stop right after prepare async") {
+    StalledServer server;
+    ff_cpp::Demuxer demuxer(server.url());
+    auto prepared = demuxer.prepareAsync({}, 30);
+    demuxer.stop();
+    REQUIRE(prepared.wait_for(std::chrono::seconds{1}) ==
+            std::future_status::ready);
+    REQUIRE_THROWS_AS(prepared.get(), ff_cpp::Interrupted);
+  }
+  SECTION("Stop demuxer queued by prepare all") {
+    StalledServer server;
+    ff_cpp::Demuxer stalled(server.url());
+    ff_cpp::Demuxer queued(url);
+    auto prepared = std::async(std::launch::async, [&]() {
+      return ff_cpp::prepareAll({&stalled, &queued}, 1, {}, 30);
+    });
+    // the only slot is taken by stalled input
+    REQUIRE(server.waitStalled());
+    queued.stop();
+    stalled.stop();
+    REQUIRE(prepared.wait_for(std::chrono::seconds{1}) ==
+            std::future_status::ready);
+    auto results = prepared.get();
+    REQUIRE_THROWS_AS(std::rethrow_exception(results[0].error),
+                      ff_cpp::Interrupted);
+    REQUIRE_THROWS_AS(std::rethrow_exception(results[1].error),
+                      ff_cpp::Interrupted);
+    // stop() before prepare() doesn't affect it
+    REQUIRE_NOTHROW(queued.prepare());
+  }
+  SECTION("Timeout of stalled prepare") {
+    StalledServer server;
+    ff_cpp::Demuxer demuxer(server.url());
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(demuxer.prepare({}, 1), ff_cpp::TimeoutElapsed);
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds{3});
+  }
+  SECTION("Stop stalled read") {
+    // peer sends beginning of stream and stalls
+    TestClip clip(25, 5, 0, "ts");
+    std::string data;
+    {
+      std::ifstream ist{clip.path(), std::ifstream::binary};
+      data.assign(std::istreambuf_iterator<char>{ist},
+                  std::istreambuf_iterator<char>{});
+    }
+    REQUIRE_FALSE(data.empty());
+    StalledServer server(data);
+    ff_cpp::Demuxer demuxer(server.url(), "mpegts");
+    demuxer.prepare({{"analyzeduration", "100000"}}, 5);
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+
+    auto waitStopped = [](std::future<int> &reading) {
+      auto stopTime = std::chrono::steady_clock::now();
+      reading.wait();
+      auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - stopTime);
+      WARN("Stop to return latency: " << latency.count() << " ms");
+      REQUIRE(latency < std::chrono::seconds{1});
+    };
+    SECTION("readPacket()") {
+      auto reading = std::async(std::launch::async, [&demuxer]() {
+        ff_cpp::Packet packet;
+        int err{};
+        while ((err = demuxer.readPacket(packet)) == 0) {
+        }
+        return err;
+      });
+      REQUIRE(server.waitStalled());
+      demuxer.stop();
+      waitStopped(reading);
+      REQUIRE(reading.get() == AVERROR_EXIT);
+    }
+    SECTION("start()") {
+      std::promise<void> firstPacket;
+      auto reading = std::async(std::launch::async, [&]() {
+        auto signaled = false;
+        demuxer.start([](ff_cpp::Frame &) {},
+                      [&](ff_cpp::Packet &) {
+                        if (!signaled) {
+                          signaled = true;
+                          firstPacket.set_value();
+                        }
+                        return true;
+                      });
+        return 0;
+      });
+      // start() reset state of previous routine, so stop() is not lost
+      REQUIRE(firstPacket.get_future().wait_for(std::chrono::seconds{10}) ==
+              std::future_status::ready);
+      REQUIRE(server.waitStalled());
+      demuxer.stop();
+      waitStopped(reading);
+      REQUIRE_NOTHROW(reading.get());
+    }
+  }
+}
+
 TEST_CASE("Operator <<", "[demuxer]") {
   SECTION("Not prepared demuxer") {
     ff_cpp::Demuxer demuxer(url);
@@ -121,6 +779,56 @@ TEST_CASE("Demuxer decoders", "[demuxer]") {
     REQUIRE(decoder.height() == 1080);
     REQUIRE(decoder.format() == static_cast<AVPixelFormat>(AV_PIX_FMT_YUV420P));
   }
+  SECTION("Decoder with explicit thread count") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    auto &decoder = demuxer.createDecoder(demuxer.bestVideoStream().index(),
+                                          AV_CODEC_ID_NONE,
+                                          {2, FF_THREAD_SLICE});
+    REQUIRE(decoder.threadCount() == 2);
+  }
+  SECTION("Decoder with default options keeps libavcodec threading") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    auto &decoder = demuxer.createDecoder(demuxer.bestVideoStream().index());
+    REQUIRE(decoder.threadCount() == 1);
+  }
+  SECTION("Decoders share thread budget") {
+    const auto budget = ff_cpp::decodeThreadBudget();
+    ff_cpp::DecoderOptions options;
+    options.shareThreadBudget = true;
+    auto createDecoder = [&options](ff_cpp::Demuxer &demuxer) -> auto & {
+      demuxer.prepare();
+      return demuxer.createDecoder(demuxer.bestVideoStream().index(),
+                                   AV_CODEC_ID_NONE, options);
+    };
+
+    ff_cpp::setDecodeThreadBudget({4, 2});
+    {
+      ff_cpp::Demuxer first(url);
+      REQUIRE(createDecoder(first).threadCount() == 2);
+      ff_cpp::Demuxer second(url);
+      REQUIRE(createDecoder(second).threadCount() == 2);
+      ff_cpp::Demuxer third(url);
+      REQUIRE(createDecoder(third).threadCount() == 1);
+    }
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE(createDecoder(demuxer).threadCount() == 2);
+
+    // burst without expected number of decoders doesn't exceed budget while
+    // it lasts, every next decoder gets one thread
+    ff_cpp::setDecodeThreadBudget({6, 1});
+    std::vector<std::unique_ptr<ff_cpp::Demuxer>> burst;
+    int threads{};
+    for (int i = 0; i < 4; i++) {
+      burst.push_back(std::make_unique<ff_cpp::Demuxer>(url));
+      threads += createDecoder(*burst.back()).threadCount();
+    }
+    // 2 of 6 threads are still taken by the decoder created above, first
+    // decoder of burst gets half of the budget, the rest gets what is left
+    REQUIRE(threads == 3 + 1 + 1 + 1);
+    ff_cpp::setDecodeThreadBudget(budget);
+  }
   SECTION("Create decoder twice for the same index") {
     ff_cpp::Demuxer demuxer(url);
     demuxer.prepare();
@@ -129,6 +837,139 @@ TEST_CASE("Demuxer decoders", "[demuxer]") {
   }
 }
 
+TEST_CASE("Decode modes", "[demuxer]") {
+  auto decodeAll = [](const ff_cpp::DecoderOptions &options,
+                      std::vector<int64_t> &timestamps) {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    auto &decoder = demuxer.createDecoder(demuxer.bestVideoStream().index(),
+                                          AV_CODEC_ID_NONE, options);
+    for (auto &frame : demuxer.frames()) {
+      timestamps.push_back(frame.pts());
+    }
+    REQUIRE(decoder.stats().decoded == timestamps.size());
+    return decoder.stats();
+  };
+
+  std::vector<int64_t> allTimestamps;
+  auto allStats = decodeAll({}, allTimestamps);
+  REQUIRE(allStats.skipped == 0);
+
+  SECTION("Keyframes only") {
+    std::vector<int64_t> timestamps;
+    auto stats = decodeAll({0, FF_THREAD_FRAME | FF_THREAD_SLICE,
+                            ff_cpp::DecodeMode::KeyframesOnly},
+                           timestamps);
+    REQUIRE(stats.decoded >= 1);
+    REQUIRE(stats.decoded < allStats.decoded);
+    REQUIRE(stats.decoded + stats.skipped == allStats.decoded);
+  }
+  SECTION("Fast decoding") {
+    for (auto speed :
+         {ff_cpp::DecodeSpeed::Fast, ff_cpp::DecodeSpeed::Fastest}) {
+      ff_cpp::DecoderOptions options;
+      options.speed = speed;
+      std::vector<int64_t> timestamps;
+      auto stats = decodeAll(options, timestamps);
+      // h264 decoder doesn't support lowres, so resolution is the same
+      REQUIRE(stats.decoded == allStats.decoded);
+      REQUIRE(timestamps == allTimestamps);
+    }
+  }
+  SECTION("Motion vectors") {
+    for (auto exportMotionVectors : {false, true}) {
+      ff_cpp::DecoderOptions options;
+      options.exportMotionVectors = exportMotionVectors;
+      ff_cpp::Demuxer demuxer(url);
+      demuxer.prepare();
+      demuxer.createDecoder(demuxer.bestVideoStream().index(),
+                            AV_CODEC_ID_NONE, options);
+      int framesWithVectors{};
+      double maxScore{};
+      for (auto &frame : demuxer.frames()) {
+        framesWithVectors += !frame.motionVectors().empty();
+        const auto score = ff_cpp::motionScore(frame);
+        maxScore = std::max(maxScore, score);
+        double maxLength{};
+        for (const auto &mv : frame.motionVectors()) {
+          REQUIRE(mv.motion_scale > 0);
+          maxLength = std::max(
+              maxLength, std::hypot(static_cast<double>(mv.motion_x),
+                                    static_cast<double>(mv.motion_y)) /
+                             mv.motion_scale);
+        }
+        // weighted mean of lengths, even if bi-predicted blocks have two
+        // vectors
+        REQUIRE(score <= maxLength + 1e-9);
+      }
+      if (exportMotionVectors) {
+        REQUIRE(framesWithVectors > 0);
+        REQUIRE(maxScore > 0);
+      } else {
+        REQUIRE(framesWithVectors == 0);
+        REQUIRE(maxScore == 0);
+      }
+    }
+  }
+  SECTION("Target fps") {
+    constexpr double targetFps = 10;
+    std::vector<int64_t> timestamps;
+    auto stats = decodeAll({0, FF_THREAD_FRAME | FF_THREAD_SLICE,
+                            ff_cpp::DecodeMode::TargetFps, targetFps},
+                           timestamps);
+    REQUIRE(stats.decoded >= 1);
+    REQUIRE(stats.skipped >= 1);
+    // source is 60 fps, so about every 6th frame is decoded
+    REQUIRE(stats.decoded <= allStats.decoded / 6 + 1);
+
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    const auto timeBase = av_q2d(demuxer.bestVideoStream().timeBase());
+    for (size_t i = 1; i < timestamps.size(); i++) {
+      REQUIRE((timestamps[i] - timestamps[i - 1]) * timeBase >
+              0.5 / targetFps);
+    }
+  }
+}
+
+TEST_CASE("Demuxer stream selection", "[demuxer]") {
+  SECTION("Not prepared demuxer") {
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE_THROWS_AS(demuxer.selectStreams({0}), ff_cpp::FFCppException);
+  }
+  SECTION("Not existing stream index") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    REQUIRE_THROWS_AS(demuxer.selectStreams({demuxer.streams().size()}),
+                      ff_cpp::NoStream);
+  }
+  SECTION("Only packets of selected stream are read") {
+    auto countPackets = [](ff_cpp::Demuxer &demuxer, int &videoPackets) {
+      int packetsCount{};
+      const auto videoIndex =
+          static_cast<int>(demuxer.bestVideoStream().index());
+      for (auto &pkt : demuxer.packets()) {
+        packetsCount++;
+        videoPackets += pkt.streamIndex() == videoIndex;
+      }
+      return packetsCount;
+    };
+
+    int allVideoPackets{};
+    ff_cpp::Demuxer allDemuxer(url);
+    allDemuxer.prepare();
+    countPackets(allDemuxer, allVideoPackets);
+
+    int selectedVideoPackets{};
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.selectStreams({demuxer.bestVideoStream().index()});
+    REQUIRE(countPackets(demuxer, selectedVideoPackets) ==
+            selectedVideoPackets);
+    REQUIRE(selectedVideoPackets == allVideoPackets);
+  }
+}
+
 TEST_CASE("Start/Stop demuxer", "[demuxer]") {
   SECTION("Start not prepared demuxer") {
     ff_cpp::Demuxer demuxer(url);
@@ -155,6 +996,1166 @@ TEST_CASE("Start/Stop demuxer", "[demuxer]") {
   }
 }
 
+TEST_CASE("Per-stream handlers", "[demuxer]") {
+  SECTION("Not prepared demuxer") {
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE_THROWS_AS(
+        demuxer.onPacket(0, [](ff_cpp::Packet &) { return true; }),
+        ff_cpp::FFCppException);
+    REQUIRE_THROWS_AS(demuxer.onFrame(0, [](ff_cpp::Frame &) {}),
+                      ff_cpp::FFCppException);
+  }
+  SECTION("Not existing stream index") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    REQUIRE_THROWS_AS(demuxer.onFrame(demuxer.streams().size(),
+                                      [](ff_cpp::Frame &) {}),
+                      ff_cpp::NoStream);
+  }
+  SECTION("Handlers replace common callbacks for their stream") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    demuxer.createDecoder(videoIndex);
+
+    int videoPackets{};
+    int videoFrames{};
+    demuxer.onPacket(videoIndex,
+                     [&videoPackets, videoIndex](ff_cpp::Packet &pkt) {
+                       REQUIRE(pkt.streamIndex() ==
+                               static_cast<int>(videoIndex));
+                       videoPackets++;
+                       return true;
+                     });
+    demuxer.onFrame(videoIndex, [&demuxer, &videoFrames](ff_cpp::Frame &frm) {
+      REQUIRE(frm.width() == 1920);
+      if (++videoFrames == 10) {
+        demuxer.stop();
+      }
+    });
+    demuxer.start(
+        [](ff_cpp::Frame &) { FAIL("Frame of stream with handler"); },
+        [videoIndex](ff_cpp::Packet &pkt) {
+          REQUIRE(pkt.streamIndex() != static_cast<int>(videoIndex));
+          return true;
+        });
+    REQUIRE(videoFrames == 10);
+    REQUIRE(videoPackets >= videoFrames);
+  }
+  SECTION("Handlers in pipelined routine") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    demuxer.createDecoder(videoIndex);
+
+    int videoFrames{};
+    demuxer.onFrame(videoIndex, [&demuxer, &videoFrames](ff_cpp::Frame &) {
+      if (++videoFrames == 10) {
+        demuxer.stop();
+      }
+    });
+    REQUIRE_NOTHROW(demuxer.start(
+        [](ff_cpp::Frame &) { FAIL("Frame of stream with handler"); },
+        [](ff_cpp::Packet &) { return true; }, ff_cpp::PipelineOptions{}));
+    REQUIRE(videoFrames == 10);
+  }
+}
+
+TEST_CASE("Pipelined demuxer", "[demuxer]") {
+  SECTION("Start not prepared demuxer") {
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE_THROWS_AS(demuxer.start([](ff_cpp::Frame &) {},
+                                    [](ff_cpp::Packet &) { return true; },
+                                    ff_cpp::PipelineOptions{}),
+                      ff_cpp::FFCppException);
+  }
+  SECTION("Packet moved out of callback outlives demuxer") {
+    std::vector<ff_cpp::Packet> kept;
+    {
+      ff_cpp::Demuxer demuxer(url);
+      demuxer.prepare();
+      demuxer.createDecoder(demuxer.bestVideoStream().index());
+      REQUIRE_NOTHROW(demuxer.start(
+          [](ff_cpp::Frame &) {},
+          [&demuxer, &kept](ff_cpp::Packet &pkt) {
+            kept.push_back(std::move(pkt));
+            if (kept.size() == 3) {
+              demuxer.stop();
+            }
+            return false;
+          },
+          ff_cpp::PipelineOptions{4, 2}));
+    }
+    // packets taken from pool of destroyed demuxer are still valid
+    REQUIRE(kept.size() == 3);
+    for (const auto &pkt : kept) {
+      REQUIRE(pkt.streamIndex() >= 0);
+    }
+    kept.clear();
+  }
+  SECTION("Start and stop from frame callback") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    int framesCount{};
+    REQUIRE_NOTHROW(demuxer.start(
+        [&demuxer, &framesCount](ff_cpp::Frame &frm) {
+          REQUIRE(frm.width() == 1920);
+          REQUIRE(frm.height() == 1080);
+          if (++framesCount == 10) {
+            demuxer.stop();
+          }
+        },
+        [&demuxer](ff_cpp::Packet &pkt) {
+          return pkt.streamIndex() == demuxer.bestVideoStream().index();
+        },
+        ff_cpp::PipelineOptions{4, 2}));
+    REQUIRE(framesCount == 10);
+  }
+  SECTION("All frames delivered before end of file") {
+    int serialCount{};
+    {
+      ff_cpp::Demuxer demuxer(url);
+      demuxer.prepare();
+      demuxer.createDecoder(demuxer.bestVideoStream().index());
+      REQUIRE_THROWS_AS(
+          demuxer.start([&serialCount](ff_cpp::Frame &) { serialCount++; }),
+          ff_cpp::EndOfFile);
+    }
+    int pipelinedCount{};
+    {
+      ff_cpp::Demuxer demuxer(url);
+      demuxer.prepare();
+      demuxer.createDecoder(demuxer.bestVideoStream().index());
+      REQUIRE_THROWS_AS(
+          demuxer.start(
+              [&pipelinedCount](ff_cpp::Frame &) { pipelinedCount++; },
+              [](ff_cpp::Packet &) { return true; }, ff_cpp::PipelineOptions{}),
+          ff_cpp::EndOfFile);
+    }
+    // serial routine doesn't flush decoder on end of file
+    REQUIRE(pipelinedCount >= serialCount);
+    REQUIRE(pipelinedCount > 0);
+  }
+  SECTION("Drop policies") {
+    TestClip clip(100, 10);
+    const auto gopSize = static_cast<size_t>(clip.frames() / clip.gops());
+    // consumer is blocked on the first frame until every packet is demuxed,
+    // so full queues drop items regardless of speed of threads
+    auto run = [&clip](const ff_cpp::PipelineOptions &options,
+                       ff_cpp::PipelineStats &stats, bool slowConsumer) {
+      ff_cpp::Demuxer demuxer(clip.url());
+      demuxer.prepare();
+      const auto videoIndex = demuxer.bestVideoStream().index();
+      demuxer.createDecoder(videoIndex);
+      // frame numbers of delivered frames
+      std::vector<size_t> delivered;
+      Latch demuxed;
+      size_t packets{};
+      auto waited = true;
+      REQUIRE_THROWS_AS(
+          demuxer.start(
+              [&](ff_cpp::Frame &frame) {
+                if (slowConsumer && !demuxed.wait()) {
+                  waited = false;
+                }
+                delivered.push_back(static_cast<size_t>(
+                    av_rescale_q(frame.pts(),
+                                 demuxer.bestVideoStream().timeBase(),
+                                 AVRational{1, TestClip::fps})));
+              },
+              [&](ff_cpp::Packet &) {
+                if (++packets == static_cast<size_t>(clip.frames())) {
+                  demuxed.open();
+                }
+                return true;
+              },
+              options),
+          ff_cpp::EndOfFile);
+      REQUIRE(waited);
+      stats = demuxer.pipelineStats();
+      return delivered;
+    };
+    // decoding resumes only from keyframes after dropped packets
+    auto resumesAtKeyframes = [gopSize](const std::vector<size_t> &frames) {
+      for (size_t i = 1; i < frames.size(); i++) {
+        if (frames[i] != frames[i - 1] + 1 && frames[i] % gopSize != 0) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    ff_cpp::PipelineStats stats;
+    const auto all = run(ff_cpp::PipelineOptions{}, stats, false).size();
+    REQUIRE(all == static_cast<size_t>(clip.frames()));
+    REQUIRE(stats.packetsDropped == 0);
+    REQUIRE(stats.framesDropped == 0);
+
+    ff_cpp::PipelineOptions options;
+    options.frameQueueSize = 1;
+    options.framePolicy = ff_cpp::DropPolicy::KeepLatest;
+    auto delivered = run(options, stats, true);
+    REQUIRE(stats.framesDropped > 0);
+    REQUIRE(stats.packetsDropped == 0);
+    REQUIRE(delivered.size() + stats.framesDropped == all);
+    REQUIRE(delivered.back() == all - 1);
+
+    options.framePolicy = ff_cpp::DropPolicy::DropOldest;
+    delivered = run(options, stats, true);
+    REQUIRE(stats.framesDropped > 0);
+    REQUIRE(delivered.size() + stats.framesDropped == all);
+    REQUIRE(delivered.back() == all - 1);
+
+    options.packetQueueSize = 2;
+    options.packetPolicy = ff_cpp::DropPolicy::DropUntilKeyframe;
+    options.framePolicy = ff_cpp::DropPolicy::Block;
+    delivered = run(options, stats, true);
+    REQUIRE(stats.packetsDropped > 0);
+    REQUIRE(stats.framesDropped == 0);
+    REQUIRE(delivered.size() + stats.packetsDropped == all);
+    REQUIRE(delivered.size() < all);
+    REQUIRE(resumesAtKeyframes(delivered));
+
+    // queue holds more than a GOP, so it keeps the whole last GOP
+    options.packetQueueSize = 2 * gopSize;
+    options.packetPolicy = ff_cpp::DropPolicy::KeepLatest;
+    delivered = run(options, stats, true);
+    REQUIRE(stats.packetsDropped > 0);
+    REQUIRE(delivered.size() + stats.packetsDropped == all);
+    REQUIRE(resumesAtKeyframes(delivered));
+    REQUIRE(delivered.size() >= gopSize);
+    const std::vector<size_t> lastGop(delivered.end() - gopSize,
+                                      delivered.end());
+    for (size_t i = 0; i < gopSize; i++) {
+      REQUIRE(lastGop[i] == all - gopSize + i);
+    }
+  }
+}
+
+TEST_CASE("Pull demuxer", "[demuxer]") {
+  SECTION("Not prepared demuxer") {
+    ff_cpp::Demuxer demuxer(url);
+    ff_cpp::Packet pkt;
+    ff_cpp::Frame frm;
+    REQUIRE(demuxer.readPacket(pkt) == AVERROR(EINVAL));
+    REQUIRE(demuxer.nextFrame(frm) == AVERROR(EINVAL));
+    REQUIRE_THROWS_AS(demuxer.packets().begin(), ff_cpp::FFCppException);
+  }
+  SECTION("Read packets until end of file") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    ff_cpp::Packet pkt;
+    int err{};
+    int packetsCount{};
+    while ((err = demuxer.readPacket(pkt)) == 0) {
+      REQUIRE(pkt.streamIndex() < static_cast<int>(demuxer.streams().size()));
+      packetsCount++;
+    }
+    REQUIRE(err == AVERROR_EOF);
+    REQUIRE(packetsCount > 0);
+    REQUIRE(demuxer.readPacket(pkt) == AVERROR_EOF);
+
+    ff_cpp::Demuxer rangeDemuxer(url);
+    rangeDemuxer.prepare();
+    int rangePacketsCount{};
+    for (auto &packet : rangeDemuxer.packets()) {
+      REQUIRE(packet.streamIndex() >= 0);
+      rangePacketsCount++;
+    }
+    REQUIRE(rangePacketsCount == packetsCount);
+  }
+  SECTION("Decode frames until end of file") {
+    int callbackFramesCount{};
+    {
+      ff_cpp::Demuxer demuxer(url);
+      demuxer.prepare();
+      demuxer.createDecoder(demuxer.bestVideoStream().index());
+      REQUIRE_THROWS_AS(
+          demuxer.start([&callbackFramesCount](ff_cpp::Frame &) {
+            callbackFramesCount++;
+          }),
+          ff_cpp::EndOfFile);
+    }
+
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    int framesCount{};
+    for (auto &frame : demuxer.frames()) {
+      REQUIRE(frame.width() == 1920);
+      REQUIRE(frame.height() == 1080);
+      framesCount++;
+    }
+    // frames left in decoder are flushed at the end of file
+    REQUIRE(framesCount >= callbackFramesCount);
+    ff_cpp::Frame frame;
+    REQUIRE(demuxer.nextFrame(frame) == AVERROR_EOF);
+  }
+}
+
+TEST_CASE("Non throwing API", "[demuxer]") {
+  SECTION("Prepare") {
+    ff_cpp::Demuxer badDemuxer("invalid\\url");
+    auto status = badDemuxer.tryPrepare();
+    REQUIRE_FALSE(status);
+    REQUIRE(status.code() == ff_cpp::StatusCode::BadInput);
+    REQUIRE(status.error() < 0);
+    REQUIRE_FALSE(status.message().empty());
+    REQUIRE_THROWS_AS(badDemuxer.prepare(), ff_cpp::BadInput);
+
+    ff_cpp::Demuxer optionsDemuxer(url);
+    status = optionsDemuxer.tryPrepare({{"invalid", "parameter"}});
+    REQUIRE(status.code() == ff_cpp::StatusCode::OptionsNotAccepted);
+    ff_cpp::Demuxer throwingDemuxer(url);
+    try {
+      throwingDemuxer.prepare({{"invalid", "parameter"}});
+      FAIL();
+    } catch (const ff_cpp::OptionsNotAccepted &e) {
+      REQUIRE(e.NotAcceptedOptions().count("invalid") == 1);
+    }
+
+    ff_cpp::Demuxer demuxer(url);
+    status = demuxer.tryPrepare();
+    REQUIRE(status);
+    REQUIRE(status.code() == ff_cpp::StatusCode::Ok);
+  }
+  SECTION("Read and decode") {
+    STATIC_REQUIRE(noexcept(std::declval<ff_cpp::Demuxer &>().readPacket(
+        std::declval<ff_cpp::Packet &>())));
+    STATIC_REQUIRE(noexcept(std::declval<ff_cpp::Decoder &>().sendPacket(
+        std::declval<ff_cpp::Packet &>())));
+    STATIC_REQUIRE(noexcept(std::declval<ff_cpp::Decoder &>().receiveFrame(
+        std::declval<ff_cpp::Frame &>())));
+
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE(demuxer.tryPrepare());
+    ff_cpp::Packet pkt;
+    int err{};
+    while ((err = demuxer.readPacket(pkt)) == 0) {
+    }
+    auto status = ff_cpp::Status::fromError(err);
+    REQUIRE(status.code() == ff_cpp::StatusCode::EndOfFile);
+    REQUIRE_THROWS_AS(status.throwIfError(), ff_cpp::EndOfFile);
+    REQUIRE(ff_cpp::Status::fromError(0));
+    REQUIRE(ff_cpp::Status::fromError(AVERROR(EAGAIN)).code() ==
+            ff_cpp::StatusCode::TryAgain);
+  }
+  SECTION("Start") {
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE(demuxer.tryPrepare());
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    int framesCount{};
+    auto status = demuxer.tryStart(
+        [&framesCount](ff_cpp::Frame &) { framesCount++; },
+        [](ff_cpp::Packet &) { return true; });
+    REQUIRE(status.code() == ff_cpp::StatusCode::EndOfFile);
+    REQUIRE(framesCount > 0);
+
+    ff_cpp::Demuxer stoppedDemuxer(url);
+    REQUIRE(stoppedDemuxer.tryPrepare());
+    status = stoppedDemuxer.tryStart(
+        [](ff_cpp::Frame &) {},
+        [&stoppedDemuxer](ff_cpp::Packet &) {
+          stoppedDemuxer.stop();
+          return false;
+        });
+    REQUIRE(status.code() == ff_cpp::StatusCode::Interrupted);
+  }
+  SECTION("Filter") {
+    constexpr int width = 64;
+    constexpr int height = 64;
+    constexpr int format = AV_PIX_FMT_GRAY8;
+    ff_cpp::Filter filter("null", width, height, format);
+    ff_cpp::Frame out;
+    for (int i = 0; i < 3; i++) {
+      ff_cpp::Frame frame{width, height, format};
+      auto status = filter.tryFilter(frame, out);
+      REQUIRE(status);
+      REQUIRE(out.width() == width);
+      REQUIRE(out.height() == height);
+    }
+  }
+}
+
+TEST_CASE("Frame subscribers", "[demuxer]") {
+  ff_cpp::Demuxer demuxer(url);
+  demuxer.prepare();
+  demuxer.createDecoder(demuxer.bestVideoStream().index());
+
+  // callbacks run on subscriber threads, so they only count
+  std::atomic<size_t> allFrames{};
+  std::atomic<size_t> badFrames{};
+  std::atomic<size_t> latestFrames{};
+  std::atomic<size_t> otherStreamFrames{};
+
+  ff_cpp::SubscriberOptions blocking;
+  blocking.queueSize = 4;
+  blocking.policy = ff_cpp::DropPolicy::Block;
+  auto all = demuxer.subscribe(
+      [&allFrames, &badFrames](ff_cpp::Frame &frame) {
+        if (frame.width() != 1920) {
+          badFrames++;
+        }
+        allFrames++;
+      },
+      blocking);
+  // slow subscriber is blocked on its first frame until all frames are
+  // decoded, so it drops frames regardless of speed of threads
+  Latch decodedAll;
+  std::atomic<bool> waited{true};
+  ff_cpp::SubscriberOptions latest;
+  latest.queueSize = 1;
+  latest.policy = ff_cpp::DropPolicy::KeepLatest;
+  auto slow = demuxer.subscribe(
+      [&latestFrames, &decodedAll, &waited](ff_cpp::Frame &) {
+        if (!decodedAll.wait()) {
+          waited = false;
+        }
+        latestFrames++;
+      },
+      latest);
+  ff_cpp::SubscriberOptions otherStream;
+  otherStream.streamIndex = static_cast<int>(demuxer.streams().size());
+  auto other = demuxer.subscribe(
+      [&otherStreamFrames](ff_cpp::Frame &) { otherStreamFrames++; },
+      otherStream);
+  auto failing = demuxer.subscribe([](ff_cpp::Frame &) {
+    throw std::runtime_error("Subscriber failed");
+  });
+
+  size_t decoded{};
+  for (auto &frame : demuxer.frames()) {
+    REQUIRE(frame.width() == 1920);
+    decoded++;
+  }
+  REQUIRE(decoded > 2);
+  decodedAll.open();
+
+  auto stats = demuxer.subscriberStats();
+  REQUIRE(stats.size() == 4);
+  REQUIRE(stats[0].id == all);
+  REQUIRE(stats[0].dropped == 0);
+  // only the frame in callback and the last one are not dropped
+  REQUIRE(stats[1].dropped >= decoded - 2);
+  REQUIRE(stats[2].dropped == 0);
+
+  for (auto id : {all, slow, other}) {
+    demuxer.unsubscribe(id);
+  }
+  REQUIRE(allFrames == decoded);
+  REQUIRE(badFrames == 0);
+  REQUIRE(latestFrames + stats[1].dropped == decoded);
+  REQUIRE(waited);
+  REQUIRE(otherStreamFrames == 0);
+
+  for (int i = 0; i < 100 && !demuxer.subscriberStats().front().error; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  stats = demuxer.subscriberStats();
+  REQUIRE(stats.size() == 1);
+  REQUIRE(stats.front().id == failing);
+  REQUIRE(stats.front().delivered == 0);
+  REQUIRE_THROWS_AS(std::rethrow_exception(stats.front().error),
+                    std::runtime_error);
+  demuxer.unsubscribe(failing);
+  REQUIRE(demuxer.subscriberStats().empty());
+  REQUIRE_THROWS_AS(demuxer.unsubscribe(failing), ff_cpp::FFCppException);
+}
+
+TEST_CASE("Seek and keyframe index", "[demuxer]") {
+  SECTION("Not prepared demuxer") {
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE_THROWS_AS(demuxer.seek(0), ff_cpp::FFCppException);
+    REQUIRE_THROWS_AS(demuxer.keyframeIndex(0), ff_cpp::FFCppException);
+  }
+  SECTION("Seek to keyframes") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    const auto videoIndex = static_cast<int>(demuxer.bestVideoStream().index());
+    auto index = demuxer.keyframeIndex(videoIndex);
+    REQUIRE(index.streamIndex == videoIndex);
+    REQUIRE(!index.timestamps.empty());
+    REQUIRE(std::is_sorted(index.timestamps.begin(), index.timestamps.end()));
+
+    demuxer.selectStreams({static_cast<size_t>(videoIndex)});
+    for (auto it = index.timestamps.rbegin(); it != index.timestamps.rend();
+         ++it) {
+      demuxer.seek(*it, AVSEEK_FLAG_BACKWARD, videoIndex);
+      ff_cpp::Packet packet;
+      REQUIRE(demuxer.readPacket(packet) == 0);
+      REQUIRE(packet.dts() == *it);
+    }
+  }
+}
+
+TEST_CASE("Accurate seek", "[demuxer]") {
+  std::vector<int64_t> sequential;
+  {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    for (auto &frame : demuxer.frames()) {
+      sequential.push_back(frame.pts());
+    }
+  }
+  std::sort(sequential.begin(), sequential.end());
+  REQUIRE(sequential.size() > 2);
+
+  auto checkFrameAt = [&sequential](ff_cpp::Demuxer &demuxer) {
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    // backward order makes every call seek
+    for (auto i = sequential.size(); i-- > 0;) {
+      if (i % 7 != 0 && i + 1 != sequential.size()) {
+        continue;
+      }
+      REQUIRE(demuxer.frameAt(videoIndex, sequential[i]).pts() ==
+              sequential[i]);
+    }
+    REQUIRE(demuxer.frameAt(videoIndex, sequential[1] - 1).pts() ==
+            sequential[0]);
+    REQUIRE(demuxer.frameAt(videoIndex, sequential[0] - 1000).pts() ==
+            sequential[0]);
+  };
+
+  SECTION("Stream without decoder") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    REQUIRE_THROWS_AS(demuxer.frameAt(demuxer.bestVideoStream().index(), 0),
+                      ff_cpp::FFCppException);
+  }
+  SECTION("Seek by demuxer") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    checkFrameAt(demuxer);
+  }
+  SECTION("Seek by keyframe index loaded from sidecar file") {
+    TempFile sidecar{"keyframe_index.txt"};
+    {
+      ff_cpp::Demuxer demuxer(url);
+      demuxer.prepare();
+      demuxer.keyframeIndex(demuxer.bestVideoStream().index())
+          .save(sidecar.path());
+    }
+
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    auto index = ff_cpp::KeyframeIndex::load(sidecar.path());
+    REQUIRE(index.timestamps ==
+            demuxer.keyframeIndex(demuxer.bestVideoStream().index())
+                .timestamps);
+    demuxer.setKeyframeIndex(index);
+    checkFrameAt(demuxer);
+  }
+  SECTION("Decoder is usable after frameAt() reached end of file") {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    auto &decoder = demuxer.createDecoder(videoIndex);
+    REQUIRE(demuxer.frameAt(videoIndex, sequential.back()).pts() ==
+            sequential.back());
+
+    ff_cpp::Demuxer other(url);
+    other.prepare();
+    ff_cpp::Packet packet;
+    do {
+      REQUIRE(other.readPacket(packet) == 0);
+    } while (packet.streamIndex() != static_cast<int>(videoIndex));
+    REQUIRE(decoder.sendPacket(packet) == 0);
+  }
+  SECTION("Load malformed keyframe index") {
+    REQUIRE_THROWS_AS(ff_cpp::KeyframeIndex::load("not_existing_index.txt"),
+                      ff_cpp::BadInput);
+    TempFile sidecar{"malformed_index.txt"};
+    std::ofstream{sidecar.path()}
+        << "ff_cpp keyframe index 2\n0 1 1000 2\n-1 -1\n10 0\n";
+    REQUIRE_THROWS_AS(ff_cpp::KeyframeIndex::load(sidecar.path()),
+                      ff_cpp::BadInput);
+  }
+  SECTION("Keyframe index of other input is rejected") {
+    TestClip clip(20, 10);
+    TestClip otherClip(40, 10);
+    ff_cpp::Demuxer other(otherClip.url());
+    other.prepare();
+    auto otherIndex = other.keyframeIndex(other.bestVideoStream().index());
+
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    REQUIRE_THROWS_AS(demuxer.setKeyframeIndex(otherIndex), ff_cpp::BadInput);
+
+    auto index = demuxer.keyframeIndex(videoIndex);
+    REQUIRE(index.inputSize > 0);
+    auto otherTimeBase = index;
+    otherTimeBase.timeBase.den *= 2;
+    REQUIRE_THROWS_AS(demuxer.setKeyframeIndex(otherTimeBase),
+                      ff_cpp::BadInput);
+    REQUIRE_NOTHROW(demuxer.setKeyframeIndex(index));
+  }
+}
+
+TEST_CASE("Frame cache", "[cache]") {
+  // pts of every frame of clip in display order
+  auto decodeAll = [](const TestClip &clip) {
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    std::vector<int64_t> sequential;
+    for (auto &frame : demuxer.frames()) {
+      sequential.push_back(frame.pts());
+    }
+    std::sort(sequential.begin(), sequential.end());
+    REQUIRE(sequential.size() == static_cast<size_t>(clip.frames()));
+    return sequential;
+  };
+
+  SECTION("Stream without decoder") {
+    TestClip clip(20, 10);
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    ff_cpp::FrameCache cache(demuxer);
+    REQUIRE_THROWS_AS(cache.frameAt(videoIndex, 0), ff_cpp::FFCppException);
+    REQUIRE_THROWS_AS(cache.frameAt(demuxer.streams().size(), 0),
+                      ff_cpp::NoStream);
+  }
+  SECTION("Scrubbing hits cached GOPs") {
+    // with B-frames keyframe is decoded before the frame displayed right
+    // before it, so that frame is found in GOP before the indexed one
+    TestClip clip(100, 10, 2);
+    const auto sequential = decodeAll(clip);
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    demuxer.createDecoder(videoIndex);
+    const auto gops = demuxer.keyframeIndex(videoIndex).timestamps.size();
+    REQUIRE(gops > 1);
+    auto keyframesAfterDisplayedFrames = 0;
+    ff_cpp::Packet packet;
+    while (demuxer.readPacket(packet) == 0) {
+      if (packet.isKeyframe() && packet.dts() < packet.pts()) {
+        keyframesAfterDisplayedFrames++;
+      }
+    }
+    // the first keyframe has no frames before it
+    REQUIRE(keyframesAfterDisplayedFrames >= static_cast<int>(gops) - 1);
+
+    ff_cpp::FrameCache cache(demuxer);
+    // scrub over whole stream twice, every GOP is decoded once
+    for (int pass = 0; pass < 2; pass++) {
+      for (auto pts : sequential) {
+        REQUIRE(cache.frameAt(videoIndex, pts).pts() == pts);
+      }
+    }
+    auto stats = cache.stats();
+    REQUIRE(stats.misses == gops);
+    REQUIRE(stats.hits == 2 * sequential.size() - gops);
+    REQUIRE(stats.evictions == 0);
+    REQUIRE(stats.gops == gops);
+    REQUIRE(stats.frames == sequential.size());
+    REQUIRE(stats.bytes == sequential.size() * TestClip::frameBytes());
+
+    cache.clear();
+    REQUIRE(cache.stats().frames == 0);
+    REQUIRE(cache.stats().bytes == 0);
+  }
+  SECTION("Memory limit evicts GOPs which are not next to the cursor") {
+    TestClip clip(100, 10);
+    const auto sequential = decodeAll(clip);
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    demuxer.createDecoder(videoIndex);
+    // two and a half GOPs
+    ff_cpp::FrameCache cache(demuxer, 25 * TestClip::frameBytes());
+
+    REQUIRE(cache.frameAt(videoIndex, sequential[40]).pts() == sequential[40]);
+    REQUIRE(cache.frameAt(videoIndex, sequential[80]).pts() == sequential[80]);
+    // GOP of frame 40 is least recently used, but it is next to the cursor
+    REQUIRE(cache.frameAt(videoIndex, sequential[30]).pts() == sequential[30]);
+    auto stats = cache.stats();
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.gops == 2);
+    REQUIRE(stats.bytes == 20 * TestClip::frameBytes());
+
+    REQUIRE(cache.frameAt(videoIndex, sequential[45]).pts() == sequential[45]);
+    REQUIRE(cache.stats().hits == 1);
+    // GOP of frame 30 is least recently used and not next to the cursor
+    REQUIRE(cache.frameAt(videoIndex, sequential[85]).pts() == sequential[85]);
+    REQUIRE(cache.frameAt(videoIndex, sequential[49]).pts() == sequential[49]);
+    stats = cache.stats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 4);
+    REQUIRE(stats.evictions == 2);
+    REQUIRE(stats.gops == 2);
+    REQUIRE(stats.bytes == 20 * TestClip::frameBytes());
+  }
+  SECTION("GOP larger than memory limit keeps frames around requested one") {
+    TestClip clip(100, 10);
+    const auto sequential = decodeAll(clip);
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    const auto videoIndex = demuxer.bestVideoStream().index();
+    demuxer.createDecoder(videoIndex);
+    ff_cpp::FrameCache cache(demuxer, 4 * TestClip::frameBytes());
+
+    // frames 22-25 are kept
+    REQUIRE(cache.frameAt(videoIndex, sequential[25]).pts() == sequential[25]);
+    auto stats = cache.stats();
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.frames == 4);
+    REQUIRE(stats.bytes == 4 * TestClip::frameBytes());
+    REQUIRE(cache.frameAt(videoIndex, sequential[22]).pts() == sequential[22]);
+    REQUIRE(cache.stats().hits == 1);
+
+    // dropped frames decode GOP again, frames 20-23 and then 24-27 are kept
+    REQUIRE(cache.frameAt(videoIndex, sequential[21]).pts() == sequential[21]);
+    REQUIRE(cache.frameAt(videoIndex, sequential[23]).pts() == sequential[23]);
+    REQUIRE(cache.frameAt(videoIndex, sequential[27]).pts() == sequential[27]);
+    stats = cache.stats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 3);
+    REQUIRE(stats.evictions == 0);
+    REQUIRE(stats.gops == 1);
+    REQUIRE(stats.frames == 4);
+    REQUIRE(stats.bytes == 4 * TestClip::frameBytes());
+
+    // neighbour of the cursor is evicted when nothing else is left
+    REQUIRE(cache.frameAt(videoIndex, sequential[35]).pts() == sequential[35]);
+    stats = cache.stats();
+    REQUIRE(stats.misses == 4);
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.gops == 1);
+    REQUIRE(stats.bytes == 4 * TestClip::frameBytes());
+  }
+}
+
+TEST_CASE("Batch decoder", "[batch]") {
+  std::vector<int64_t> sequential;
+  {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    for (auto &frame : demuxer.frames()) {
+      sequential.push_back(frame.pts());
+    }
+  }
+
+  SECTION("Invalid input") {
+    ff_cpp::BatchDecoder decoder("invalid_url");
+    REQUIRE_THROWS_AS(decoder.decode([](ff_cpp::Frame &) {}),
+                      ff_cpp::BadInput);
+  }
+  SECTION("Ordered delivery") {
+    ff_cpp::BatchDecoder decoder(url);
+    std::vector<int64_t> batch;
+    ff_cpp::BatchOptions options;
+    options.threads = 4;
+    options.framesPerThread = 8;
+    decoder.decode([&batch](ff_cpp::Frame &frame) {
+      REQUIRE(frame.width() == 1920);
+      batch.push_back(frame.pts());
+    }, options);
+    REQUIRE(batch == sequential);
+  }
+  SECTION("Unordered delivery") {
+    ff_cpp::BatchDecoder decoder(url);
+    std::vector<int64_t> batch;
+    ff_cpp::BatchOptions options;
+    options.ordered = false;
+    decoder.decode([&batch](ff_cpp::Frame &frame) {
+      batch.push_back(frame.pts());
+    }, options);
+    std::sort(batch.begin(), batch.end());
+    auto sorted = sequential;
+    std::sort(sorted.begin(), sorted.end());
+    REQUIRE(batch == sorted);
+  }
+  SECTION("Stop from frame callback") {
+    ff_cpp::BatchDecoder decoder(url);
+    int framesCount{};
+    REQUIRE_NOTHROW(decoder.decode([&decoder, &framesCount](ff_cpp::Frame &) {
+      if (++framesCount == 10) {
+        decoder.stop();
+      }
+    }));
+    REQUIRE(framesCount == 10);
+  }
+  SECTION("Ordered delivery of many GOPs") {
+    TestClip clip(100, 10);
+    std::vector<int64_t> clipSequential;
+    {
+      ff_cpp::Demuxer demuxer(clip.url());
+      demuxer.prepare();
+      auto videoIndex = demuxer.bestVideoStream().index();
+      demuxer.createDecoder(videoIndex);
+      REQUIRE(demuxer.keyframeIndex(videoIndex).timestamps.size() ==
+              static_cast<size_t>(clip.gops()));
+      for (auto &frame : demuxer.frames()) {
+        clipSequential.push_back(frame.pts());
+      }
+    }
+    REQUIRE(clipSequential.size() == static_cast<size_t>(clip.frames()));
+
+    ff_cpp::BatchDecoder decoder(clip.url());
+    ff_cpp::BatchOptions options;
+    options.threads = 4;
+    options.framesPerThread = 2;
+    for (size_t gopsPerRange : {1, 3}) {
+      options.gopsPerRange = gopsPerRange;
+      std::vector<int64_t> batch;
+      decoder.decode(
+          [&batch](ff_cpp::Frame &frame) {
+            REQUIRE(frame.width() == TestClip::width);
+            batch.push_back(frame.pts());
+          },
+          options);
+      REQUIRE(batch == clipSequential);
+    }
+  }
+  SECTION("Stop from other thread") {
+    TestClip clip(100, 5);
+    ff_cpp::BatchOptions options;
+    options.threads = 2;
+    options.framesPerThread = 1;
+    for (auto delay : {0, 1, 5, 20}) {
+      ff_cpp::BatchDecoder decoder(clip.url());
+      std::atomic<bool> started{};
+      auto decoding = std::async(std::launch::async, [&]() {
+        decoder.decode(
+            [&started](ff_cpp::Frame &) {
+              started = true;
+              // slow consumer, so workers wait for delivery
+              std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            },
+            options);
+      });
+      while (!started && decoding.wait_for(std::chrono::milliseconds{1}) !=
+                             std::future_status::ready) {
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{delay});
+      decoder.stop();
+      REQUIRE(decoding.wait_for(std::chrono::seconds{5}) ==
+              std::future_status::ready);
+      REQUIRE_NOTHROW(decoding.get());
+    }
+  }
+}
+
+TEST_CASE("Demuxer pool", "[pool]") {
+  size_t expected{};
+  {
+    ff_cpp::Demuxer demuxer(url);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    for (auto &frame : demuxer.frames()) {
+      (void)frame;
+      expected++;
+    }
+  }
+  REQUIRE(expected > 0);
+
+  SECTION("Not prepared demuxer") {
+    ff_cpp::DemuxerPool pool;
+    ff_cpp::Demuxer demuxer(url);
+    REQUIRE_THROWS_AS(pool.add(demuxer, [](ff_cpp::Frame &) {}),
+                      ff_cpp::FFCppException);
+    REQUIRE_THROWS_AS(pool.remove(0), ff_cpp::FFCppException);
+  }
+  SECTION("More inputs than workers") {
+    const size_t inputs = 6;
+    ff_cpp::DemuxerPoolOptions options;
+    options.threads = 2;
+    ff_cpp::DemuxerPool pool{options};
+    std::vector<std::unique_ptr<ff_cpp::Demuxer>> demuxers;
+    // callbacks run on worker threads, so they only count
+    std::vector<size_t> frames(inputs);
+    std::atomic<size_t> badFrames{};
+    for (size_t i = 0; i < inputs; i++) {
+      demuxers.push_back(std::make_unique<ff_cpp::Demuxer>(url));
+      auto &demuxer = *demuxers.back();
+      demuxer.prepare();
+      demuxer.createDecoder(demuxer.bestVideoStream().index());
+      auto id =
+          pool.add(demuxer, [&frames, &badFrames, i](ff_cpp::Frame &frame) {
+            if (frame.width() != 1920) {
+              badFrames++;
+            }
+            frames[i]++;
+          });
+      REQUIRE(id == i);
+    }
+    pool.wait();
+
+    REQUIRE(badFrames == 0);
+    auto stats = pool.stats();
+    REQUIRE(stats.inputs.size() == inputs);
+    for (size_t i = 0; i < inputs; i++) {
+      REQUIRE(frames[i] == expected);
+      const auto &input = stats.inputs[i];
+      REQUIRE(input.demuxer == demuxers[i].get());
+      REQUIRE(input.finished);
+      REQUIRE_FALSE(input.error);
+      REQUIRE(input.frames == expected);
+      REQUIRE(input.packets >= expected);
+      REQUIRE(input.turns > 0);
+      REQUIRE(input.maxLag >= input.averageLag);
+    }
+  }
+  SECTION("Remove and stop") {
+    ff_cpp::DemuxerPoolOptions options;
+    options.threads = 1;
+    ff_cpp::DemuxerPool pool{options};
+    ff_cpp::Demuxer first(url);
+    ff_cpp::Demuxer second(url);
+    for (auto demuxer : {&first, &second}) {
+      demuxer->prepare();
+      demuxer->createDecoder(demuxer->bestVideoStream().index());
+    }
+    auto id = pool.add(first, [](ff_cpp::Frame &) {});
+    pool.add(second, [&second](ff_cpp::Frame &) { second.stop(); });
+    pool.remove(id);
+    pool.wait();
+    auto stats = pool.stats();
+    REQUIRE(stats.inputs.size() == 1);
+    REQUIRE(stats.inputs.front().finished);
+    REQUIRE(stats.inputs.front().frames < expected);
+
+    // removed demuxer is in blocking mode again
+    ff_cpp::Packet packet;
+    auto err = first.readPacket(packet);
+    REQUIRE((err == 0 || err == AVERROR_EOF));
+
+    pool.stop();
+    REQUIRE_THROWS_AS(pool.add(first, [](ff_cpp::Frame &) {}),
+                      ff_cpp::FFCppException);
+  }
+  SECTION("Live input without data") {
+    // FLV tags are read whole, so demuxer stops right at end of pushed data
+    TestClip clip(25, 5, 0, "flv");
+    auto source = std::make_shared<LiveSource>();
+    source->push(readFile(clip.path()));
+    ff_cpp::Demuxer demuxer(source, "flv");
+    demuxer.prepare({{"analyzeduration", "100000"}});
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+
+    ff_cpp::DemuxerPoolOptions options;
+    options.threads = 1;
+    options.maxBackoff = std::chrono::milliseconds{5};
+    options.readTimeout = std::chrono::milliseconds{200};
+    ff_cpp::DemuxerPool pool{options};
+    std::atomic<size_t> frames{};
+    const auto added = std::chrono::steady_clock::now();
+    pool.add(demuxer, [&frames](ff_cpp::Frame &) { frames++; });
+
+    SECTION("Times out") {
+      pool.wait();
+      REQUIRE(std::chrono::steady_clock::now() - added >=
+              options.readTimeout);
+      const auto stats = pool.stats().inputs.front();
+      REQUIRE(stats.wouldBlock > 0);
+      REQUIRE(stats.frames == frames);
+      REQUIRE(frames > 0);
+      REQUIRE_THROWS_AS(std::rethrow_exception(stats.error),
+                        ff_cpp::TimeoutElapsed);
+    }
+    SECTION("Finishes when input closed") {
+      while (pool.stats().inputs.front().wouldBlock == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+      source->close();
+      pool.wait();
+      const auto stats = pool.stats().inputs.front();
+      REQUIRE_FALSE(stats.error);
+      REQUIRE(frames == static_cast<size_t>(clip.frames()));
+    }
+  }
+  SECTION("Idle worker steals input of busy one") {
+    TestClip clip(20, 10);
+    ff_cpp::DemuxerPoolOptions options;
+    options.threads = 2;
+    ff_cpp::DemuxerPool pool{options};
+    std::vector<std::unique_ptr<ff_cpp::Demuxer>> demuxers;
+    for (size_t i = 0; i < 3; i++) {
+      demuxers.push_back(std::make_unique<ff_cpp::Demuxer>(clip.url()));
+      demuxers.back()->prepare();
+      demuxers.back()->createDecoder(
+          demuxers.back()->bestVideoStream().index());
+    }
+    // inputs are queued to workers in turn: blocked and released ones to the
+    // first worker, the other one to the second. Worker which holds blocked
+    // input waits until released input is served by the other worker, so it
+    // is stolen unless blocked input itself was stolen
+    Latch released;
+    std::atomic<bool> waited{true};
+    pool.add(*demuxers[0], [&](ff_cpp::Frame &) {
+      if (!released.wait()) {
+        waited = false;
+      }
+    });
+    pool.add(*demuxers[1], [](ff_cpp::Frame &) {});
+    pool.add(*demuxers[2], [&released](ff_cpp::Frame &) { released.open(); });
+    pool.wait();
+    REQUIRE(waited);
+    REQUIRE(pool.stats().steals > 0);
+    for (const auto &input : pool.stats().inputs) {
+      REQUIRE_FALSE(input.error);
+      REQUIRE(input.frames == static_cast<uint64_t>(clip.frames()));
+    }
+  }
+  SECTION("Stop finishes input in the middle of turn") {
+    TestClip clip(20, 10);
+    ff_cpp::DemuxerPoolOptions options;
+    options.threads = 1;
+    options.packetsPerTurn = 1000;
+    ff_cpp::DemuxerPool pool{options};
+    ff_cpp::Demuxer demuxer(clip.url());
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    size_t packets{};
+    pool.add(demuxer, [](ff_cpp::Frame &) {},
+             [&demuxer, &packets](ff_cpp::Packet &) {
+               if (++packets == 3) {
+                 demuxer.stop();
+               }
+               return true;
+             });
+    pool.wait();
+    REQUIRE(packets == 3);
+  }
+}
+
+TEST_CASE("Custom input source", "[demuxer]") {
+  const std::string path("small_bunny_1080p_60fps.mp4");
+  auto checkDemuxer = [](ff_cpp::Demuxer &demuxer) {
+    REQUIRE_NOTHROW(demuxer.prepare());
+    auto &vStream = demuxer.bestVideoStream();
+    REQUIRE(vStream.codec() == AV_CODEC_ID_H264);
+    REQUIRE(vStream.width() == 1920);
+    REQUIRE(vStream.height() == 1080);
+    demuxer.createDecoder(vStream.index());
+    int framesCount{};
+    demuxer.start(
+        [&demuxer, &framesCount](ff_cpp::Frame &frm) {
+          REQUIRE(frm.width() == 1920);
+          if (++framesCount == 5) {
+            demuxer.stop();
+          }
+        },
+        [&vStream](ff_cpp::Packet &pkt) {
+          return pkt.streamIndex() == vStream.index();
+        });
+    REQUIRE(framesCount == 5);
+  };
+  SECTION("Memory buffer") {
+    std::ifstream f(path, std::ifstream::binary);
+    REQUIRE(f);
+    std::vector<uint8_t> data{std::istreambuf_iterator<char>(f),
+                              std::istreambuf_iterator<char>()};
+    REQUIRE(!data.empty());
+    ff_cpp::Demuxer demuxer(data.data(), data.size());
+    checkDemuxer(demuxer);
+  }
+  SECTION("Memory mapped file") {
+    auto source = std::make_shared<ff_cpp::MemorySource>(path);
+    REQUIRE(source->size() > 0);
+    REQUIRE(source->name() == path);
+    ff_cpp::Demuxer demuxer(source);
+    REQUIRE(demuxer.inputSource() == path);
+    checkDemuxer(demuxer);
+  }
+  SECTION("Prefetched file") {
+    auto source = std::make_shared<ff_cpp::PrefetchSource>(
+        path, ff_cpp::PrefetchOptions{64 * 1024, 4});
+    ff_cpp::Demuxer demuxer(source);
+    checkDemuxer(demuxer);
+    auto stats = source->stats();
+    REQUIRE(stats.bytesConsumed > 0);
+    REQUIRE(stats.bytesRead >= stats.bytesConsumed);
+  }
+  SECTION("Prepare again") {
+    // source which could be switched to fail every read
+    class FailingSource : public ff_cpp::MemorySource {
+     public:
+      using MemorySource::MemorySource;
+      int read(uint8_t *buf, int size) override {
+        return fail ? AVERROR(EIO) : MemorySource::read(buf, size);
+      }
+      bool fail{};
+    };
+    auto source = std::make_shared<FailingSource>(path);
+    ff_cpp::Demuxer demuxer(source);
+    checkDemuxer(demuxer);
+    const auto streamsCount = demuxer.streams().size();
+    checkDemuxer(demuxer);
+    REQUIRE(demuxer.streams().size() == streamsCount);
+
+    // failed prepare keeps previous input, its io context and position of
+    // source, so packets are read further as if prepare was not called
+    ff_cpp::Demuxer reference(std::make_shared<ff_cpp::MemorySource>(path));
+    reference.prepare();
+    demuxer.prepare();
+    ff_cpp::Packet packet;
+    ff_cpp::Packet expected;
+    for (int i = 0; i < 20; i++) {
+      REQUIRE(demuxer.readPacket(packet) == 0);
+      REQUIRE(reference.readPacket(expected) == 0);
+    }
+    source->fail = true;
+    REQUIRE_THROWS_AS(demuxer.prepare(), ff_cpp::BadInput);
+    source->fail = false;
+    REQUIRE(demuxer.streams().size() == streamsCount);
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(demuxer.readPacket(packet) == 0);
+      REQUIRE(reference.readPacket(expected) == 0);
+      REQUIRE(packet.streamIndex() == expected.streamIndex());
+      REQUIRE(packet.pts() == expected.pts());
+      REQUIRE(packet.dts() == expected.dts());
+    }
+    checkDemuxer(demuxer);
+  }
+  SECTION("Probing of new input failed") {
+    // source which stops demuxer on read once armed, custom io is not
+    // interrupted, so input is opened and probing of it is interrupted
+    class StoppingSource : public ff_cpp::MemorySource {
+     public:
+      using MemorySource::MemorySource;
+      int read(uint8_t *buf, int size) override {
+        if (demuxer) {
+          demuxer->stop();
+        }
+        return MemorySource::read(buf, size);
+      }
+      ff_cpp::Demuxer *demuxer{};
+    };
+    auto source = std::make_shared<StoppingSource>(path);
+    ff_cpp::Demuxer demuxer(source);
+    demuxer.prepare();
+    demuxer.createDecoder(demuxer.bestVideoStream().index());
+    source->demuxer = &demuxer;
+    REQUIRE_THROWS_AS(demuxer.prepare(), ff_cpp::Interrupted);
+    source->demuxer = nullptr;
+    REQUIRE(demuxer.streams().empty());
+    REQUIRE(demuxer.decoders().empty());
+    REQUIRE_THROWS_AS(demuxer.bestVideoStream(), ff_cpp::NoStream);
+    checkDemuxer(demuxer);
+  }
+  SECTION("Not existing file") {
+    REQUIRE_THROWS_AS(ff_cpp::MemorySource{"not_existing_file.mp4"},
+                      ff_cpp::BadInput);
+    REQUIRE_THROWS_AS(ff_cpp::PrefetchSource{"not_existing_file.mp4"},
+                      ff_cpp::BadInput);
+  }
+  SECTION("Empty file") {
+    ff_cpp::Demuxer demuxer(
+        std::make_shared<ff_cpp::MemorySource>("empty_file.mp4"));
+    REQUIRE_THROWS_AS(demuxer.prepare(), ff_cpp::BadInput);
+  }
+}
+
 TEST_CASE("Packet tests", "[packet]") {
   SECTION("Contruction/Destruction") {
     {
@@ -164,6 +2165,48 @@ TEST_CASE("Packet tests", "[packet]") {
       REQUIRE(pkt.streamIndex() == 0);
     }
   }
+  SECTION("Packet pool") {
+    constexpr size_t capacity = 4;
+    ff_cpp::PacketPool pool{capacity};
+    REQUIRE(pool.capacity() == capacity);
+    REQUIRE(pool.available() == capacity);
+    {
+      std::vector<ff_cpp::Packet> packets;
+      for (size_t i = 0; i < capacity; i++) {
+        packets.emplace_back(pool);
+        REQUIRE(packets.back().pts() == AV_NOPTS_VALUE);
+      }
+      REQUIRE(pool.available() == 0);
+      // exhausted pool falls back to heap allocation
+      ff_cpp::Packet extraPkt{pool};
+      REQUIRE(extraPkt.pts() == AV_NOPTS_VALUE);
+      REQUIRE(pool.available() == 0);
+    }
+    REQUIRE(pool.available() == capacity);
+  }
+  SECTION("Packet outlives pool") {
+    auto pool = std::make_unique<ff_cpp::PacketPool>(2);
+    ff_cpp::Packet pkt{*pool};
+    pool.reset();
+    REQUIRE(pkt.pts() == AV_NOPTS_VALUE);
+  }
+  SECTION("Packet pool used from several threads") {
+    constexpr size_t capacity = 8;
+    ff_cpp::PacketPool pool{capacity};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&pool]() {
+        for (int i = 0; i < 10000; i++) {
+          ff_cpp::Packet first{pool};
+          ff_cpp::Packet second{pool};
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    REQUIRE(pool.available() == capacity);
+  }
 }
 
 TEST_CASE("Frame tests", "[frame]") {
@@ -227,6 +2270,111 @@ TEST_CASE("Frame tests", "[frame]") {
     }
     REQUIRE(buf[0] == magicNum);
   }
+  SECTION("Construct from pool") {
+    constexpr int width = 1918;
+    constexpr int height = 1080;
+    constexpr int format = AV_PIX_FMT_GRAY8;
+    ff_cpp::FramePool pool;
+    uint8_t *firstData{};
+    {
+      ff_cpp::Frame frame{pool, width, height, format, 4};
+      REQUIRE(frame.width() == width);
+      REQUIRE(frame.height() == height);
+      REQUIRE(frame.format() == format);
+      REQUIRE(frame.linesize()[0] == 1920);
+      firstData = frame.data()[0];
+    }
+    {
+      ff_cpp::Frame frame{pool, width, height, format, 4};
+      REQUIRE(frame.data()[0] == firstData);
+      ff_cpp::Frame otherFrame{pool, width, height, format, 4};
+      REQUIRE(otherFrame.data()[0] != firstData);
+    }
+    auto stats = pool.stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.peakBuffers == 2);
+    REQUIRE_THROWS_AS((ff_cpp::Frame{pool, 0, height, format}),
+                      ff_cpp::FFCppException);
+  }
+  SECTION("Shallow copy and deep clone") {
+    constexpr int width = 100;
+    constexpr int height = 100;
+    constexpr int format = AV_PIX_FMT_RGB24;
+    constexpr int imgSize = width * height * 3;
+    ff_cpp::Frame frame{width, height, format};
+    std::fill(frame.data()[0], frame.data()[0] + imgSize, uint8_t{42});
+    frame.setPts(7);
+
+    ff_cpp::Frame copy{frame};
+    REQUIRE(copy.data()[0] == frame.data()[0]);
+    REQUIRE(copy.pts() == 7);
+    auto ref = frame.ref();
+    REQUIRE(ref.data()[0] == frame.data()[0]);
+
+    auto clone = frame.clone();
+    REQUIRE(clone.data()[0] != frame.data()[0]);
+    REQUIRE(clone.width() == width);
+    REQUIRE(clone.height() == height);
+    REQUIRE(clone.format() == format);
+    REQUIRE(clone.pts() == 7);
+    REQUIRE(std::equal(frame.data()[0], frame.data()[0] + imgSize,
+                       clone.data()[0]));
+
+    ff_cpp::Frame assigned;
+    assigned = frame;
+    REQUIRE(assigned.data()[0] == frame.data()[0]);
+    assigned = ff_cpp::Frame{};
+    REQUIRE(assigned.data()[0] == nullptr);
+  }
+  SECTION("Copy of not reference-counted frame copies data") {
+    constexpr int width = 100;
+    constexpr int height = 100;
+    constexpr int format = AV_PIX_FMT_RGB24;
+    std::unique_ptr<uint8_t[]> buf{new uint8_t[width * height * 3]{}};
+    ff_cpp::Frame frame{buf.get(), width, height, format};
+    ff_cpp::Frame copy{frame};
+    REQUIRE(copy.data()[0] != nullptr);
+    REQUIRE(copy.data()[0] != buf.get());
+    REQUIRE(copy.width() == width);
+  }
+  SECTION("Copy of empty frame") {
+    ff_cpp::Frame frame;
+    ff_cpp::Frame copy{frame};
+    REQUIRE(copy.data()[0] == nullptr);
+    REQUIRE(copy.format() == -1);
+    REQUIRE(frame.clone().data()[0] == nullptr);
+  }
+  SECTION("Take ownership of allocated buffer") {
+    constexpr int width = 100;
+    constexpr int height = 100;
+    constexpr int format = AV_PIX_FMT_RGB24;
+    int deleterCalls{};
+    auto deleter = [&deleterCalls](uint8_t *ptr) {
+      deleterCalls++;
+      delete[] ptr;
+    };
+    auto buf = new uint8_t[width * height * 3];
+    {
+      ff_cpp::Frame frame{buf, width, height, format, 1, deleter};
+      REQUIRE(frame.width() == width);
+      REQUIRE(frame.height() == height);
+      REQUIRE(frame.format() == format);
+      REQUIRE(frame.data()[0] == buf);
+      REQUIRE(frame.linesize()[0] == width * 3);
+      {
+        auto ref = frame.ref();
+        REQUIRE(ref.data()[0] == buf);
+      }
+      REQUIRE(deleterCalls == 0);
+    }
+    REQUIRE(deleterCalls == 1);
+
+    REQUIRE_THROWS_AS((ff_cpp::Frame{new uint8_t[1], 0, height, format, 1,
+                                     deleter}),
+                      ff_cpp::FFCppException);
+    REQUIRE(deleterCalls == 2);
+  }
   SECTION("Check if alignment work") {
     constexpr int width = 1918;
     constexpr int height = 1080;
@@ -239,6 +2387,89 @@ TEST_CASE("Frame tests", "[frame]") {
   }
 }
 
+TEST_CASE("Lock-free queues", "[queue]") {
+  SECTION("SPSC queue of frames") {
+    ff_cpp::FrameSpscQueue queue{3};
+    REQUIRE(queue.capacity() == 4);
+    for (int i = 0; i < 4; i++) {
+      ff_cpp::Frame frame{64, 64, AV_PIX_FMT_GRAY8};
+      frame.setPts(i);
+      REQUIRE(queue.tryPush(std::move(frame)));
+    }
+    ff_cpp::Frame extra{64, 64, AV_PIX_FMT_GRAY8};
+    REQUIRE_FALSE(queue.tryPush(std::move(extra)));
+    // rejected frame is not moved
+    REQUIRE(extra.width() == 64);
+    REQUIRE(queue.size() == 4);
+
+    for (int i = 0; i < 4; i++) {
+      auto frame = queue.tryPop();
+      REQUIRE(frame);
+      REQUIRE(frame->pts() == i);
+      REQUIRE(frame->width() == 64);
+    }
+    REQUIRE_FALSE(queue.tryPop());
+  }
+  SECTION("Closed queue") {
+    ff_cpp::PacketMpmcQueue queue{4};
+    REQUIRE(queue.push(ff_cpp::Packet{}));
+    queue.close();
+    REQUIRE(queue.closed());
+    REQUIRE_FALSE(queue.push(ff_cpp::Packet{}));
+    // queued packets are still delivered
+    REQUIRE(queue.pop());
+    REQUIRE_FALSE(queue.pop());
+  }
+  SECTION("Blocked pop is woken by close") {
+    ff_cpp::FrameMpmcQueue queue{4};
+    std::atomic<bool> woken{};
+    std::thread consumer{[&queue, &woken]() {
+      woken = !queue.pop(ff_cpp::QueueWait::Block);
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    queue.close();
+    consumer.join();
+    REQUIRE(woken);
+  }
+  SECTION("Packet handles between threads") {
+    constexpr int producers = 3;
+    constexpr int consumers = 3;
+    constexpr int packetsPerProducer = 5000;
+    ff_cpp::PacketPool pool{16};
+    for (auto wait : {ff_cpp::QueueWait::Block, ff_cpp::QueueWait::Spin}) {
+      ff_cpp::PacketMpmcQueue queue{4};
+      std::atomic<int> pushed{};
+      std::atomic<int> popped{};
+      std::vector<std::thread> threads;
+      for (int i = 0; i < consumers; i++) {
+        threads.emplace_back([&queue, &popped, wait]() {
+          while (auto packet = queue.pop(wait)) {
+            popped++;
+          }
+        });
+      }
+      std::vector<std::thread> producerThreads;
+      for (int i = 0; i < producers; i++) {
+        producerThreads.emplace_back([&queue, &pool, &pushed, wait]() {
+          for (int p = 0; p < packetsPerProducer; p++) {
+            pushed += queue.push(ff_cpp::Packet{pool}, wait);
+          }
+        });
+      }
+      for (auto& thread : producerThreads) {
+        thread.join();
+      }
+      queue.close();
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      REQUIRE(pushed == producers * packetsPerProducer);
+      REQUIRE(popped == pushed);
+      REQUIRE(pool.available() == pool.capacity());
+    }
+  }
+}
+
 TEST_CASE("Filter tests", "[filter]") {
   const std::string filterDescr = "boxblur=10";
   SECTION("Filter creation") {
@@ -352,6 +2583,39 @@ TEST_CASE("Filter tests", "[filter]") {
     REQUIRE(filteredFrm.height() == height);
     REQUIRE(filteredFrm.format() == format);
   }
+  SECTION("Filter not reference-counted frame using pool") {
+    constexpr int width = 1920;
+    constexpr int height = 1080;
+    constexpr int format = AV_PIX_FMT_RGB24;
+    const std::string filterDescr = "format=pix_fmts=yuv420p";
+    std::unique_ptr<uint8_t[]> buf{new uint8_t[width * height * 3]{}};
+
+    ff_cpp::Frame inFrm{buf.get(), width, height, format};
+    ff_cpp::Filter filter(filterDescr, width, height, format);
+    ff_cpp::FramePool pool;
+    for (int i = 0; i < 3; i++) {
+      auto filteredFrm = filter.filter(inFrm, pool, true);
+      REQUIRE(filteredFrm.width() == width);
+      REQUIRE(filteredFrm.height() == height);
+      REQUIRE(filteredFrm.format() == AV_PIX_FMT_YUV420P);
+    }
+    REQUIRE(inFrm.data()[0] == buf.get());
+    REQUIRE(pool.stats().hits + pool.stats().misses == 3);
+  }
+  SECTION("Filter keeps reference to owned buffer instead of copy") {
+    constexpr int width = 1920;
+    constexpr int height = 1080;
+    constexpr int format = AV_PIX_FMT_RGB24;
+    const std::string filterDescr = "format=pix_fmts=rgb24";
+    auto buf = new uint8_t[width * height * 3]{};
+
+    ff_cpp::Frame inFrm{buf, width, height, format, 1,
+                        [](uint8_t *ptr) { delete[] ptr; }};
+    ff_cpp::Filter filter(filterDescr, width, height, format);
+    auto filteredFrm = filter.filter(inFrm, true);
+    REQUIRE(inFrm.data()[0] == buf);
+    REQUIRE(filteredFrm.data()[0] == buf);
+  }
   SECTION("Filter frame with aligned buffer") {
     constexpr int width = 1918;
     constexpr int height = 1080;
@@ -397,6 +2661,16 @@ TEST_CASE("Scaler tests", "[scaler]") {
     ff_cpp::Frame dstFrame{width, height, dstFormat, alignment};
     scaler.scale(srcFrame, dstFrame);
 
+    ff_cpp::FramePool pool;
+    for (int i = 0; i < 3; i++) {
+      auto pooledFrame = scaler.scale(srcFrame, alignment, pool);
+      REQUIRE(pooledFrame.width() == width);
+      REQUIRE(pooledFrame.height() == height);
+      REQUIRE(pooledFrame.format() == dstFormat);
+    }
+    REQUIRE(pool.stats().misses == 1);
+    REQUIRE(pool.stats().hits == 2);
+
     SUCCEED();
   }
 }
\ No newline at end of file